@@ -39,19 +39,59 @@ const vector<string> Defaults = {
   "8/8/5k2/7p/8/6RR/3K4/8 w 0 1 moves h3h5" // draw by counting rules
 };
 
+// A larger set for performance tracking, taken from engine self-play games
+const vector<string> Extended = {
+  // Openings
+  "2s1ks1r/r1m1n3/ppnp1ppp/4p3/2P1P3/PP3PPP/2NN4/R1SKMS1R w 2 8",
+  "r3ks1r/2snn3/p2mpppp/8/8/P1P1PPPP/3NN3/R1SKMS1R w 4 8",
+  "2smks1r/r2n4/pppp1pn1/4p3/5P1p/PPPPP1P1/2KNN3/R1S1MS1R w 0 8",
+  "r1s1k1nr/3nm3/p1pp2sp/Pp2pp2/3P4/1PP1PPP1/3N4/R1SKMSNR w 0 8",
+
+  // Middlegames
+  "5s1r/r1msn1k1/p1np2p1/1p2pp1p/1PP1P2P/P1S1NPP1/3N2K1/R3MS1R w 0 16",
+  "1r6/2s1nks1/p2mppp1/2n5/2N3PP/P1P1P3/2S1N3/1K2MS1R w 1 16",
+  "3mk2r/r1sn1s2/3p1pn1/1p6/p2PPP2/1PP4m/1SKNN3/R3MS1R w 0 16",
+  "r1s1k1r1/3nm3/p1p3sp/P4p2/1pP1pPnN/1P2P1P1/2K1NS2/R1S1M2R w 2 16",
+  "7r/r1msnsk1/p2p2p1/3P3p/PPN2p1P/2SS1P2/5MK1/3R3R w 6 26",
+  "1r6/2snks2/p3p3/4m2p/2P3pN/P3P3/K1S3S1/4MR2 w 2 26",
+  "3mk1s1/2sn4/3p1p2/5Pn1/S1PP4/6N1/2KN2S1/4M3 w 5 26",
+  "r7/4mkn1/p3s2p/P1p1P3/1pP1p1P1/1P2P1S1/2K5/R1S1M3 w 3 26"
+};
+
+// The endgames of the extended set, mostly subject to the counting rules
+const vector<string> Endgames = {
+  "1r6/2msn2k/p2p1s2/3P2rp/PPN1Sp2/2S2P2/4RMK1/3R4 w 0 36",
+  "5r2/2s1k3/p3pmR1/4m2p/2S5/P1M5/K7/8 w 0 36",
+  "8/2msn2k/3p4/1P1P3p/2N2p2/2S2P2/5M2/6K1 w 5 46",
+  "8/3km3/8/1SpN2s1/3P2p1/2K3M1/8/8 w 0 46",
+  "8/8/R7/P1p2nk1/1pP1p3/1P2P3/3S4/2K4r w 7 46",
+
+  // Counting rules endgames
+  "8/1km1R3/p6r/4p3/P2s4/1K6/3S4/8 w 9 56",
+  "8/8/8/1S1M1Kmk/8/4N1m1/8/8 w 0 56",
+  "8/8/4k3/8/8/3K4/8/R7 w 0 1",
+  "8/3k4/8/8/8/2SM4/4K3/8 w 0 1",
+  "8/8/8/3k4/8/2NN4/4K3/8 b 0 1",
+  "7k/8/8/8/8/2R5/3K2mp/8 w 0 1"
+};
+
 } // namespace
 
 /// setup_bench() builds a list of UCI commands to be run by bench. There
 /// are five parameters: TT size in MB, number of search threads that
 /// should be used, the limit value spent for each position, a file name
-/// where to look for positions in FEN format and the type of the limit:
-/// depth, perft, nodes and movetime (in millisecs).
+/// where to look for positions in FEN format ("default", "extended", "endgames"
+/// or "current" for the built-in sets) and the type of the limit: depth,
+/// perft, divide, nodes and movetime (in millisecs).
 ///
 /// bench -> search default positions up to depth 13
 /// bench 64 1 15 -> search default positions up to depth 15 (TT = 64MB)
 /// bench 64 4 5000 current movetime -> search current position with 4 threads for 5 sec
 /// bench 64 1 100000 default nodes -> search default positions for 100K nodes each
 /// bench 16 1 5 default perft -> run a perft 5 on default positions
+/// bench 16 1 14 extended depth 5 json -> search the extended set 5 times, add a JSON report
+/// bench json -> search the default positions, add a JSON report
+/// bench 16 1 20 endgames -> search the endgames of the extended set up to depth 20
 
 vector<string> setup_bench(const Position& current, istream& is) {
 
@@ -70,6 +110,15 @@ vector<string> setup_bench(const Position& current, istream& is) {
   if (fenFile == "default")
       fens = Defaults;
 
+  else if (fenFile == "extended")
+  {
+      fens = Extended;
+      fens.insert(fens.end(), Endgames.begin(), Endgames.end());
+  }
+
+  else if (fenFile == "endgames")
+      fens = Endgames;
+
   else if (fenFile == "current")
       fens.push_back(current.fen());
 
@@ -20,6 +20,10 @@
 
 #include <algorithm>
 
+#ifdef USE_PEXT_DISPATCH
+#  include <cpuid.h>
+#endif
+
 #include "bitboard.h"
 #include "misc.h"
 
@@ -37,12 +41,110 @@ Bitboard DistanceRingBB[SQUARE_NB][8];
 Bitboard ForwardFileBB[COLOR_NB][SQUARE_NB];
 Bitboard PassedPawnMask[COLOR_NB][SQUARE_NB];
 Bitboard PawnAttackSpan[COLOR_NB][SQUARE_NB];
-Bitboard PseudoAttacks[PIECE_TYPE_NB][SQUARE_NB];
-Bitboard PawnAttacks[COLOR_NB][SQUARE_NB];
-Bitboard BishopAttacks[COLOR_NB][SQUARE_NB];
-
 Magic RookMagics[SQUARE_NB];
-Magic BishopMagics[SQUARE_NB];
+
+#ifdef USE_PEXT_DISPATCH
+
+namespace {
+
+  // fast_pext() returns true if the CPU supports BMI2 and its pext is fast.
+  // AMD CPUs before Zen 3 (family 19h) implement pext in microcode, with a
+  // latency that depends on the mask, and are faster with magics. It runs
+  // before main(), maybe before the CPU model is read by the runtime, hence
+  // the call to __builtin_cpu_init().
+
+  bool fast_pext() {
+
+    unsigned eax, ebx, ecx, edx;
+
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("bmi2"))
+        return false;
+
+    __cpuid(0, eax, ebx, ecx, edx);
+    bool amd = (ebx == 0x68747541); // "AuthenticAMD"
+
+    __cpuid(1, eax, ebx, ecx, edx);
+    unsigned family = ((eax >> 8) & 0xF) + ((eax >> 20) & 0xFF);
+
+    return !amd || family >= 0x19;
+  }
+}
+
+// Initialized before main(), so that it is already set for engine_info()
+const bool HasPext = fast_pext();
+
+#endif
+
+#ifdef USE_DISPATCH
+const bool HasPopCnt = [] { __builtin_cpu_init(); return __builtin_cpu_supports("popcnt"); }();
+#endif
+
+namespace {
+
+  // Attacks of the step pieces and rook attacks on an empty board are computed
+  // at compile time, so that their tables are constant data. A step is on the
+  // board if it does not wrap around an edge, i.e. it moves at most two files.
+
+  constexpr int file_distance(int s1, int s2) {
+    return s1 % 8 > s2 % 8 ? s1 % 8 - s2 % 8 : s2 % 8 - s1 % 8;
+  }
+
+  constexpr Bitboard step(int s, int d) {
+    return s + d >= 0 && s + d < 64 && file_distance(s, s + d) <= 2 ? 1ULL << (s + d) : 0;
+  }
+
+  // Forward is up for white (c == 0) and down for black
+  constexpr Bitboard pawn_attacks(int c, int s) {
+    return c == 0 ? step(s, 7) | step(s, 9) : step(s, -7) | step(s, -9);
+  }
+
+  constexpr Bitboard khon_attacks(int c, int s) {
+    return c == 0 ? step(s,  7) | step(s,  8) | step(s,  9) | step(s, -7) | step(s, -9)
+                  : step(s, -7) | step(s, -8) | step(s, -9) | step(s,  7) | step(s,  9);
+  }
+
+  constexpr Bitboard met_attacks(int, int s) {
+    return step(s, 7) | step(s, 9) | step(s, -7) | step(s, -9);
+  }
+
+  constexpr Bitboard knight_attacks(int, int s) {
+    return  step(s,  6) | step(s,  10) | step(s,  15) | step(s,  17)
+          | step(s, -6) | step(s, -10) | step(s, -15) | step(s, -17);
+  }
+
+  constexpr Bitboard rook_attacks(int, int s) {
+    return ((FileABB << (s % 8)) | (Rank1BB << (8 * (s / 8)))) ^ (1ULL << s);
+  }
+
+  constexpr Bitboard king_attacks(int, int s) {
+    return  step(s,  1) | step(s,  7) | step(s,  8) | step(s,  9)
+          | step(s, -1) | step(s, -7) | step(s, -8) | step(s, -9);
+  }
+}
+
+#define S8(f, c, s) f(c, s), f(c, s + 1), f(c, s + 2), f(c, s + 3), \
+                    f(c, s + 4), f(c, s + 5), f(c, s + 6), f(c, s + 7)
+#define S64(f, c) { S8(f, c, 0), S8(f, c, 8), S8(f, c, 16), S8(f, c, 24), \
+                    S8(f, c, 32), S8(f, c, 40), S8(f, c, 48), S8(f, c, 56) }
+
+const Bitboard PawnAttacks[COLOR_NB][SQUARE_NB] = {
+  S64(pawn_attacks, 0), S64(pawn_attacks, 1)
+};
+
+const Bitboard BishopAttacks[COLOR_NB][SQUARE_NB] = {
+  S64(khon_attacks, 0), S64(khon_attacks, 1)
+};
+
+// Indexed by PieceType. Pawn and Khon attacks depend on the color and have
+// their own tables above.
+const Bitboard PseudoAttacks[PIECE_TYPE_NB][SQUARE_NB] = {
+  {}, {}, S64(met_attacks, 0), {}, S64(knight_attacks, 0),
+  S64(rook_attacks, 0), S64(king_attacks, 0), {}
+};
+
+#undef S64
+#undef S8
 
 namespace {
 
@@ -181,33 +283,13 @@ void Bitboards::init() {
               DistanceRingBB[s1][SquareDistance[s1][s2] - 1] |= s2;
           }
 
-  int steps[][6] = { {}, { 7, 9 }, { 7, 9 }, { 7, 8, 9, -7, -9 }, { 6, 10, 15, 17 }, {}, { 1, 7, 8, 9 } };
-
-  for (Color c = WHITE; c <= BLACK; ++c)
-      for (PieceType pt : { PAWN, QUEEN, BISHOP, KNIGHT, KING })
-          for (Square s = SQ_A1; s <= SQ_H8; ++s)
-              for (int i = 0; steps[pt][i]; ++i)
-              {
-                  Square to = s + Square(c == WHITE ? steps[pt][i] : -steps[pt][i]);
-
-                  if (is_ok(to) && distance(s, to) < 3)
-                  {
-                      if (pt == PAWN)
-                          PawnAttacks[c][s] |= to;
-                      else if (pt == BISHOP)
-                          BishopAttacks[c][s] |= to;
-                      else
-                          PseudoAttacks[pt][s] |= to;
-                  }
-              }
-
   Square RookDeltas[] = { NORTH,  EAST,  SOUTH,  WEST };
 
   init_magics(RookTable, RookMagics, RookDeltas);
 
   for (Square s1 = SQ_A1; s1 <= SQ_H8; ++s1)
   {
-      PseudoAttacks[ROOK][s1] = attacks_bb<  ROOK>(s1, 0);
+      assert(PseudoAttacks[ROOK][s1] == attacks_bb<ROOK>(s1, 0));
 
       for (PieceType pt : { ROOK })
           for (Square s2 = SQ_A1; s2 <= SQ_H8; ++s2)
@@ -243,13 +325,34 @@ namespace {
   }
 
 
-  // init_magics() computes all rook and bishop attacks at startup. Magic
+  // init_magics() computes all rook attacks at startup. Magic
   // bitboards are used to look up attacks of sliding pieces. As a reference see
   // chessprogramming.wikispaces.com/Magic+Bitboards. In particular, here we
   // use the so called "fancy" approach.
 
   void init_magics(Bitboard table[], Magic magics[], Square deltas[]) {
 
+    // Magics found with the seeds below for 64 bit systems, so that the search
+    // is skipped at startup. They must be updated if the seeds are changed.
+    const Bitboard RookMagics64[SQUARE_NB] = {
+      0x0A80004000801220ULL, 0x8040004010002008ULL, 0x2080200010008008ULL, 0x1100100008210004ULL,
+      0xC200209084020008ULL, 0x2100010004000208ULL, 0x0400081000822421ULL, 0x0200010422048844ULL,
+      0x0800800080400024ULL, 0x0001402000401000ULL, 0x3000801000802001ULL, 0x4400800800100083ULL,
+      0x0904802402480080ULL, 0x4040800400020080ULL, 0x0018808042000100ULL, 0x4040800080004100ULL,
+      0x0040048001458024ULL, 0x00A0004000205000ULL, 0x3100808010002000ULL, 0x4825010010000820ULL,
+      0x5004808008000401ULL, 0x2024818004000A00ULL, 0x0005808002000100ULL, 0x2100060004806104ULL,
+      0x0080400880008421ULL, 0x4062220600410280ULL, 0x010A004A00108022ULL, 0x0000100080080080ULL,
+      0x0021000500080010ULL, 0x0044000202001008ULL, 0x0000100400080102ULL, 0xC020128200040545ULL,
+      0x0080002000400040ULL, 0x0000804000802004ULL, 0x0000120022004080ULL, 0x010A386103001001ULL,
+      0x9010080080800400ULL, 0x8440020080800400ULL, 0x0004228824001001ULL, 0x000000490A000084ULL,
+      0x0080002000504000ULL, 0x200020005000C000ULL, 0x0012088020420010ULL, 0x0010010080080800ULL,
+      0x0085001008010004ULL, 0x0002000204008080ULL, 0x0040413002040008ULL, 0x0000304081020004ULL,
+      0x0080204000800080ULL, 0x3008804000290100ULL, 0x1010100080200080ULL, 0x2008100208028080ULL,
+      0x5000850800910100ULL, 0x8402019004680200ULL, 0x0120911028020400ULL, 0x0000008044010200ULL,
+      0x0020850200244012ULL, 0x0020850200244012ULL, 0x0000102001040841ULL, 0x140900040A100021ULL,
+      0x000200282410A102ULL, 0x000200282410A102ULL, 0x000200282410A102ULL, 0x4048240043802106ULL
+    };
+
     // Optimal PRNG seeds to pick the correct magics in the shortest time
     int seeds[][RANK_NB] = { { 8977, 44560, 54343, 38998,  5731, 95205, 104912, 17020 },
                              {  728, 10316, 55013, 32803, 12281, 15100,  16645,   255 } };
@@ -292,6 +395,16 @@ namespace {
         if (HasPext)
             continue;
 
+        if (Is64Bit)
+        {
+            m.magic = RookMagics64[s];
+
+            for (int i = 0; i < size; ++i)
+                m.attacks[m.index(occupancy[i])] = reference[i];
+
+            continue;
+        }
+
         PRNG rng(seeds[Is64Bit][rank_of(s)]);
 
         // Find a magic for square 's' picking up an (almost) random number
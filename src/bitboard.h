@@ -25,13 +25,6 @@
 
 #include "types.h"
 
-namespace Bitbases {
-
-void init();
-bool probe(Square wksq, Square wpsq, Square bksq, Color us);
-
-}
-
 namespace Bitboards {
 
 void init();
@@ -73,9 +66,9 @@ extern Bitboard DistanceRingBB[SQUARE_NB][8];
 extern Bitboard ForwardFileBB[COLOR_NB][SQUARE_NB];
 extern Bitboard PassedPawnMask[COLOR_NB][SQUARE_NB];
 extern Bitboard PawnAttackSpan[COLOR_NB][SQUARE_NB];
-extern Bitboard PseudoAttacks[PIECE_TYPE_NB][SQUARE_NB];
-extern Bitboard PawnAttacks[COLOR_NB][SQUARE_NB];
-extern Bitboard BishopAttacks[COLOR_NB][SQUARE_NB];
+extern const Bitboard PseudoAttacks[PIECE_TYPE_NB][SQUARE_NB];
+extern const Bitboard PawnAttacks[COLOR_NB][SQUARE_NB];
+extern const Bitboard BishopAttacks[COLOR_NB][SQUARE_NB];
 
 
 /// Magic holds all magic bitboards relevant data for a single square
@@ -101,7 +94,6 @@ struct Magic {
 };
 
 extern Magic RookMagics[SQUARE_NB];
-extern Magic BishopMagics[SQUARE_NB];
 
 
 /// Overloads of bitwise operators between a Bitboard and a Square for testing
@@ -263,7 +255,7 @@ inline Bitboard attacks_bb(PieceType pt, Square s, Bitboard occupied) {
 
 inline int popcount(Bitboard b) {
 
-#ifndef USE_POPCNT
+#if !defined(USE_POPCNT) && !defined(USE_DISPATCH)
 
   extern uint8_t PopCnt16[1 << 16];
   union { Bitboard bb; uint16_t u[4]; } v = { b };
@@ -273,7 +265,7 @@ inline int popcount(Bitboard b) {
 
   return (int)_mm_popcnt_u64(b);
 
-#else // Assumed gcc or compatible compiler
+#else // Assumed gcc or compatible compiler, popcnt instruction if the target has it
 
   return __builtin_popcountll(b);
 
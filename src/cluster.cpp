@@ -0,0 +1,615 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef USE_CLUSTER
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "cluster.h"
+#include "globals.h"
+#include "misc.h"
+#include "position.h"
+#include "uci.h"
+
+namespace Cluster {
+
+std::atomic_bool Active;
+Depth SaveDepth = Depth(10 * ONE_PLY);
+size_t Index = 0;
+
+namespace {
+
+  const size_t MaxOutbox = 1 << 16; // Entries dropped by a slow connection
+  const int SendInterval = 10;      // In milliseconds
+
+  // SocketBuf is a buffered stream on a connected socket, that it closes
+  class SocketBuf : public std::streambuf {
+
+  public:
+    explicit SocketBuf(int s) : fd(s) { setg(in, in, in); setp(out, out + sizeof(out)); }
+   ~SocketBuf() { sync(); ::close(fd); }
+    void shutdown() { ::shutdown(fd, SHUT_RDWR); } // Wakes up a blocked reader
+
+  private:
+    int underflow() {
+      ssize_t n = ::recv(fd, in, sizeof(in), 0);
+      if (n <= 0)
+          return traits_type::eof();
+
+      setg(in, in, in + n);
+      return traits_type::to_int_type(*gptr());
+    }
+
+    int overflow(int c) {
+      if (sync() == -1)
+          return traits_type::eof();
+
+      if (c != traits_type::eof())
+          *pptr() = char(c), pbump(1);
+
+      return traits_type::not_eof(c);
+    }
+
+    int sync() {
+      int result = 0;
+      for (char* p = pbase(); p < pptr() && !result; )
+      {
+          ssize_t n = ::send(fd, p, pptr() - p, MSG_NOSIGNAL);
+          if (n > 0)
+              p += n;
+          else
+              result = -1;
+      }
+      setp(out, out + sizeof(out));
+      return result;
+    }
+
+    int fd;
+    char in[4096], out[4096];
+  };
+
+  // An entry of the transposition table sent to the other nodes. The value is
+  // relative to the position, as in the table.
+  struct Entry {
+    Key key;
+    Value value, eval;
+    Bound bound;
+    Depth depth;
+    Move move;
+    size_t from; // The worker it comes from, 0 if found by this process
+  };
+
+  // A worker, seen from the master
+  struct Worker {
+    explicit Worker(int s) : buf(s), out(&buf) {}
+
+    SocketBuf buf;
+    std::ostream out;
+    std::thread reader;
+    int pending = 0;   // Searches started, whose best move has not arrived yet
+    bool hasResult = false;
+    Result result;
+  };
+
+  Mutex mutex;
+  ConditionVariable cv;
+  std::vector<std::unique_ptr<Worker>> Workers;
+  Engine* Owner;       // The instance using the workers, or serving a master
+  Result Best;
+
+  Mutex outboxMutex;
+  std::vector<Entry> Outbox;
+  std::thread Sender;
+  bool SenderExit;
+
+  std::ostream& operator<<(std::ostream& os, const Entry& e) {
+    return os << "tt " << e.key << ' ' << e.value << ' ' << e.eval << ' '
+              << e.bound << ' ' << e.depth << ' ' << e.move << '\n';
+  }
+
+  Entry read_entry(std::istream& is, size_t from) {
+    Entry e;
+    int v, ev, b, d, m;
+    is >> e.key >> v >> ev >> b >> d >> m;
+    e.value = Value(v), e.eval = Value(ev), e.bound = Bound(b), e.depth = Depth(d), e.move = Move(m);
+    e.from = from;
+    return e;
+  }
+
+  void queue(const Entry& e) {
+    std::lock_guard<Mutex> lk(outboxMutex);
+
+    if (Outbox.size() < MaxOutbox)
+        Outbox.push_back(e);
+  }
+
+  // store() saves an entry received from another node in the hash table of the
+  // current instance.
+  void store(const Entry& e) {
+    bool found;
+    TTEntry* tte = TT.probe(e.key, found);
+    tte->save(e.key, e.value, e.bound, e.depth, e.move, e.eval, TT.generation());
+  }
+
+  // send_loop() is run by the sender thread, that sends the queued entries to
+  // the master or to the workers every few milliseconds.
+  void send_loop() {
+
+    std::vector<Entry> entries;
+    std::unique_lock<Mutex> lk(mutex);
+
+    while (!SenderExit)
+    {
+        cv.wait_for(lk, std::chrono::milliseconds(SendInterval));
+
+        {
+            std::lock_guard<Mutex> olk(outboxMutex);
+            entries.clear();
+            std::swap(entries, Outbox);
+        }
+
+        if (entries.empty())
+            continue;
+
+        if (Index) // On a worker, stdout is the connection to the master
+        {
+            std::ostringstream ss;
+            for (const Entry& e : entries)
+                ss << e;
+            sync_cout << ss.str() << std::flush << IO_UNLOCK;
+            continue;
+        }
+
+        // A worker does not get back its own entries
+        for (size_t k = 0; k < Workers.size(); ++k)
+        {
+            for (const Entry& e : entries)
+                if (e.from != k + 1)
+                    Workers[k]->out << e;
+            Workers[k]->out.flush();
+        }
+    }
+  }
+
+  void start_sender() {
+    SenderExit = false;
+    Active = true;
+    Sender = std::thread(send_loop);
+  }
+
+  void stop_sender() {
+    Active = false;
+    {
+        std::lock_guard<Mutex> lk(mutex);
+        SenderExit = true;
+        cv.notify_all();
+    }
+    Sender.join();
+    Outbox.clear();
+  }
+
+  // read_worker() is run by a thread for each worker. It stores the entries of
+  // the worker, and forwards them to the other workers, and collects the result
+  // of its searches.
+  void read_worker(Worker* w, size_t from) {
+
+    Engine::Scope scope(Owner);
+    std::istream in(&w->buf);
+    std::string line, token;
+    Result result = {};
+
+    while (std::getline(in, line))
+    {
+        std::istringstream is(line);
+        is >> token;
+
+        if (token == "tt")
+        {
+            Entry e = read_entry(is, from);
+            store(e);
+            if (Workers.size() > 1)
+                queue(e);
+        }
+        else if (token == "result")
+        {
+            int d, v;
+            is >> d >> v;
+            result.depth = Depth(d), result.score = Value(v);
+        }
+        else if (token == "bestmove")
+        {
+            is >> result.bestMove >> token >> result.ponder;
+
+            std::lock_guard<Mutex> lk(mutex);
+            if (w->pending && !--w->pending)
+                w->result = result, w->hasResult = true;
+            cv.notify_all();
+            result = Result();
+        }
+    }
+
+    std::lock_guard<Mutex> lk(mutex);
+    w->pending = 0, w->hasResult = false; // Connection lost
+    cv.notify_all();
+  }
+
+  // valid_fen() tells whether a FEN received from the master can be set up.
+  // Position::set() trusts its input, so we check that the board has 8 ranks
+  // of 8 squares, at most 16 men per side with one king, no pawn on the first
+  // or last rank, and that the side to move cannot capture the other king.
+  bool valid_fen(const std::string& fen) {
+
+    const std::string PieceChars = "PMSNRKpmsnrk"; // As in Position::set()
+
+    std::istringstream is(fen);
+    std::string board, side;
+    int rank = 0, file = 0, kings[COLOR_NB] = {}, men[COLOR_NB] = {};
+    size_t idx;
+
+    if (!(is >> board >> side) || (side != "w" && side != "b"))
+        return false;
+
+    for (char c : board)
+    {
+        if (c == '/')
+        {
+            if (file != 8 || ++rank > 7)
+                return false;
+            file = 0;
+        }
+        else if (c >= '1' && c <= '8')
+            file += c - '0';
+
+        else if ((idx = PieceChars.find(c)) != std::string::npos)
+        {
+            if (file >= 8 || (idx % 6 == 0 && (rank == 0 || rank == 7)))
+                return false;
+            kings[idx / 6] += idx % 6 == 5;
+            men[idx / 6]++;
+            file++;
+        }
+        else
+            return false;
+
+        if (file > 8)
+            return false;
+    }
+
+    if (   rank != 7 || file != 8
+        || kings[WHITE] != 1 || kings[BLACK] != 1
+        || men[WHITE] > 16 || men[BLACK] > 16)
+        return false;
+
+    StateInfo st;
+    Position pos;
+    pos.set(fen, false, &st, nullptr);
+
+    return !(pos.attackers_to(pos.square<KING>(~pos.side_to_move())) & pos.pieces(pos.side_to_move()));
+  }
+
+  // allowed() tells whether a worker executes a command received from the
+  // master: the commands of a search on a valid position and the options of
+  // the search, but not the ones writing files, loading tables or changing
+  // the memory and the threads used, as 'savehash', the log file or "Hash".
+  bool allowed(const std::string& line) {
+
+    const char* SearchOptions[] = {
+      "contempt", "breadcrumbs", "clear hash", "multipv", "parallel multipv",
+      "skill level", "uci_chess960", "syzygyprobedepth", "syzygy50moverule",
+      "syzygyprobelimit"
+    };
+
+    std::istringstream is(line);
+    std::string token, name, fen;
+
+    is >> token;
+
+    if (token == "go" || token == "stop" || token == "quit")
+        return true;
+
+    if (token == "position")
+    {
+        if (!(is >> token) || token == "startpos")
+            return token == "startpos";
+
+        while (token == "fen" && is >> token && token != "moves")
+            fen += token + " ";
+
+        return !fen.empty() && valid_fen(fen);
+    }
+
+    if (token != "setoption" || !(is >> token) || token != "name")
+        return false;
+
+    while (is >> token && token != "value")
+        name += (name.empty() ? "" : " ") + token;
+
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+    return std::find(std::begin(SearchOptions), std::end(SearchOptions), name) != std::end(SearchOptions);
+  }
+
+  void disconnect() {
+
+    if (Workers.empty())
+        return;
+
+    stop_sender();
+
+    for (auto& w : Workers)
+    {
+        w->buf.shutdown();
+        w->reader.join();
+    }
+
+    Workers.clear();
+  }
+
+} // namespace
+
+
+/// Cluster::connect() connects to the workers of a comma separated list of
+/// host:port addresses, after closing any previous connection.
+
+void connect(const std::string& workers) {
+
+  disconnect();
+  Owner = Engine::CurrentEngine;
+
+  std::istringstream ss(workers);
+  std::string address;
+
+  while (std::getline(ss, address, ','))
+  {
+      size_t colon = address.rfind(':');
+      addrinfo hints = {}, *list = nullptr;
+      int s = -1;
+
+      if (address == "<empty>" || address.empty())
+          continue;
+
+      hints.ai_family = AF_UNSPEC;
+      hints.ai_socktype = SOCK_STREAM;
+
+      if (   colon != std::string::npos
+          && !getaddrinfo(address.substr(0, colon).c_str(), address.substr(colon + 1).c_str(), &hints, &list))
+          for (addrinfo* a = list; a && s == -1; a = a->ai_next)
+              if (   (s = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol)) != -1
+                  && ::connect(s, a->ai_addr, a->ai_addrlen) == -1)
+                  ::close(s), s = -1;
+
+      freeaddrinfo(list);
+
+      if (s == -1)
+      {
+          sync_cout << "info string Unable to connect to cluster worker " << address << sync_endl;
+          continue;
+      }
+
+      int one = 1;
+      setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+      Workers.emplace_back(new Worker(s));
+  }
+
+  // Start reading once the list is complete, as the readers go through it
+  for (size_t k = 0; k < Workers.size(); ++k)
+  {
+      Workers[k]->out << "index " << k + 1 << std::endl;
+      Workers[k]->reader = std::thread(read_worker, Workers[k].get(), k + 1);
+  }
+
+  if (!Workers.empty())
+  {
+      start_sender();
+      sync_cout << "info string Cluster of " << Workers.size() + 1 << " nodes" << sync_endl;
+  }
+}
+
+
+/// Cluster::detach() closes the connections to the workers when the instance
+/// using them is destroyed.
+
+void detach(const Engine* engine) {
+
+  if (engine == Owner && !Index)
+      disconnect(), Owner = nullptr;
+}
+
+
+/// Cluster::serve() waits for a master on the given port of the given local
+/// address, then executes the commands it sends, with the output going to it.
+/// When the master disconnects it waits for the next one, until the master
+/// sends 'quit'. The connection is not authenticated: anybody reaching the
+/// address can make the worker search, so it should be on a trusted network
+/// only. The commands that would write files, load tables or change the memory
+/// or the threads used are refused, as are the invalid positions, see allowed().
+
+void serve(int port, const std::string& host) {
+
+  int listener = ::socket(AF_INET, SOCK_STREAM, 0), one = 1;
+  sockaddr_in address = {};
+
+  address.sin_family = AF_INET;
+  address.sin_port = htons(uint16_t(port));
+
+  if (::inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1)
+  {
+      sync_cout << "info string Invalid address " << host << sync_endl;
+      if (listener != -1)
+          ::close(listener);
+      return;
+  }
+
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  if (   listener == -1
+      || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1
+      || ::listen(listener, 1) == -1)
+  {
+      sync_cout << "info string Unable to listen on " << host << ":" << port << sync_endl;
+      if (listener != -1)
+          ::close(listener);
+      return;
+  }
+
+  Owner = Engine::CurrentEngine;
+  bool quit = false;
+
+  while (!quit)
+  {
+      sync_cout << "info string Waiting for the master on " << host << ":" << port << sync_endl;
+
+      int s = ::accept(listener, nullptr, nullptr);
+      if (s == -1)
+          break;
+
+      setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+      SocketBuf buf(s);
+      std::istream in(&buf);
+      std::string line, token;
+      flush_output(std::cout);
+      std::streambuf* console = std::cout.rdbuf(&buf);
+
+      while (!quit && std::getline(in, line))
+      {
+          std::istringstream is(line);
+          is >> token;
+
+          if (token == "tt")
+              store(read_entry(is, 0));
+
+          else if (token == "index")
+          {
+              is >> Index;
+              start_sender();
+          }
+          else if (allowed(line))
+              quit = !UCI::command(line);
+      }
+
+      // Stop the search of a lost master, before the next one connects
+      UCI::command("stop");
+      Threads.main()->wait_for_search_finished();
+
+      if (Index)
+          stop_sender(), Index = 0;
+
+      flush_output(std::cout);
+      std::cout.rdbuf(console);
+  }
+
+  ::close(listener);
+  Owner = nullptr;
+}
+
+
+/// Cluster::start() starts the workers on the root position of the current
+/// search. They search until stop() is called.
+
+void start() {
+
+  if (Engine::CurrentEngine != Owner || Workers.empty())
+      return;
+
+  std::ostringstream go;
+  go << "go infinite";
+
+  if (!Limits.searchmoves.empty())
+      go << " searchmoves";
+
+  for (Move m : Limits.searchmoves)
+      go << ' ' << UCI::move(m);
+
+  std::lock_guard<Mutex> lk(mutex);
+
+  for (auto& w : Workers)
+  {
+      w->out << Owner->positionCmd << '\n' << go.str() << std::endl;
+      w->pending++;
+      w->hasResult = false;
+  }
+}
+
+
+/// Cluster::stop() stops the workers and waits for their best move. It returns
+/// the best result of the workers, as MainThread::search() picks the one of
+/// the threads, or nullptr if none.
+
+const Result* stop() {
+
+  if (Engine::CurrentEngine != Owner || Workers.empty())
+      return nullptr;
+
+  std::unique_lock<Mutex> lk(mutex);
+
+  for (auto& w : Workers)
+      if (w->pending)
+          w->out << "stop" << std::endl;
+
+  // Do not wait forever for a worker that does not answer, its late best move
+  // is recognized as such from the count of pending searches.
+  cv.wait_for(lk, std::chrono::seconds(1), []() {
+      for (auto& w : Workers)
+          if (w->pending)
+              return false;
+      return true;
+  });
+
+  const Result* best = nullptr;
+
+  for (auto& w : Workers)
+      if (   w->hasResult
+          && (   !best
+              || (    w->result.score > best->score
+                  && (w->result.depth >= best->depth || w->result.score >= VALUE_MATE_IN_MAX_PLY))))
+          best = &w->result;
+
+  return best ? &(Best = *best) : nullptr;
+}
+
+
+/// Cluster::send_entry() queues an entry of the hash table, to be sent to the
+/// other nodes by the sender thread.
+
+void send_entry(Key k, Value v, Bound b, Depth d, Move m, Value ev) {
+
+  queue({ k, v, ev, b, d, m, 0 });
+}
+
+} // namespace Cluster
+
+#endif // #ifdef USE_CLUSTER
@@ -0,0 +1,84 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CLUSTER_H_INCLUDED
+#define CLUSTER_H_INCLUDED
+
+#include <atomic>
+#include <string>
+
+#include "types.h"
+
+class Engine;
+
+/// Cluster lets several engine processes, usually on different machines, search
+/// the same position together. It is compiled in only with USE_CLUSTER (make
+/// cluster=yes), otherwise the functions below are empty. A worker process runs
+/// the 'serve <port> [address]' command and then takes from the connection the
+/// UCI commands of a search, listening on the loopback address by default. The
+/// connection is not authenticated, so a worker trusts the network it listens
+/// on, see serve().
+/// The process talking to the GUI, the master, connects to the workers listed
+/// in the "Cluster Workers" option and starts them on its root position at the
+/// beginning of each search. As with Lazy SMP within a process, the nodes do not
+/// split the work explicitly: they skip different iterations, share the entries
+/// of the transposition table deeper than "Cluster TT Depth", and at the end the
+/// master plays the move of the node with the best result.
+
+namespace Cluster {
+
+struct Result {
+  Depth depth;
+  Value score;
+  std::string bestMove, ponder;
+};
+
+#ifdef USE_CLUSTER
+
+extern std::atomic_bool Active; // Connected to a master or to some workers
+extern Depth SaveDepth;
+extern size_t Index;            // Of a worker, 0 for the master
+
+void connect(const std::string& workers);
+void detach(const Engine* engine);
+void serve(int port, const std::string& host);
+void start();
+const Result* stop();
+void send_entry(Key k, Value v, Bound b, Depth d, Move m, Value ev);
+
+inline void save(Key k, Value v, Bound b, Depth d, Move m, Value ev) {
+  if (d >= SaveDepth && Active)
+      send_entry(k, v, b, d, m, ev);
+}
+
+#else
+
+const size_t Index = 0;
+
+inline void detach(const Engine*) {}
+inline void start() {}
+inline const Result* stop() { return nullptr; }
+inline void save(Key, Value, Bound, Depth, Move, Value) {}
+
+#endif
+
+} // namespace Cluster
+
+#endif // #ifndef CLUSTER_H_INCLUDED
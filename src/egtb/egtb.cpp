@@ -0,0 +1,373 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstring>   // For std::memcmp
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+
+#include "../movegen.h"
+#include "../position.h"
+#include "egtb.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+using std::string;
+
+int EGTB::MaxCardinality;
+
+namespace {
+
+const string PieceOrder = "RNSMP"; // Order of the pieces of a side in a code
+
+// A mapped table file: a header followed by one byte per position
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint64_t entries;
+  char code[16];
+};
+
+struct Table {
+  Table(const string& c) : material(c) {}
+
+  EGTB::Material material;
+  const uint8_t* data = nullptr;
+};
+
+// Tables, and for each material key the table and whether white and black
+// have to be swapped to index it.
+std::vector<std::unique_ptr<Table>> Tables;
+std::map<Key, std::pair<const Table*, bool>> TableByKey;
+
+
+// map_file() maps a table file and checks its header, see TBFile::map()
+
+const uint8_t* map_file(const string& fname, const EGTB::Material& m) {
+
+  const uint8_t* data;
+  uint64_t size;
+
+#ifndef _WIN32
+  int fd = ::open(fname.c_str(), O_RDONLY);
+
+  if (fd == -1)
+      return nullptr;
+
+  struct stat statbuf;
+  fstat(fd, &statbuf);
+  size = statbuf.st_size;
+  void* base = size ? mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+  ::close(fd);
+
+  if (base == MAP_FAILED)
+      return nullptr;
+
+  data = static_cast<const uint8_t*>(base);
+#else
+  HANDLE fd = CreateFile(fname.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+  if (fd == INVALID_HANDLE_VALUE)
+      return nullptr;
+
+  DWORD size_high;
+  DWORD size_low = GetFileSize(fd, &size_high);
+  size = (uint64_t(size_high) << 32) | size_low;
+  HANDLE mmap = CreateFileMapping(fd, nullptr, PAGE_READONLY, size_high, size_low, nullptr);
+  CloseHandle(fd);
+
+  if (!mmap)
+      return nullptr;
+
+  data = static_cast<const uint8_t*>(MapViewOfFile(mmap, FILE_MAP_READ, 0, 0, 0));
+
+  if (!data)
+      return nullptr;
+#endif
+
+  const Header* h = reinterpret_cast<const Header*>(data);
+
+  if (   size != sizeof(Header) + m.entries()
+      || std::memcmp(h->magic, "MKTB", 4)
+      || h->entries != m.entries()
+      || m.code != string(h->code, strnlen(h->code, sizeof(h->code))))
+  {
+      std::cerr << "Corrupted Makruk tablebase file " << fname << std::endl;
+      return nullptr;
+  }
+
+  return data + sizeof(Header);
+}
+
+
+// index() computes the index of the position in the table with the given
+// material. If 'flip' is set, the colors are swapped and the board mirrored.
+
+uint64_t index(const Position& pos, const EGTB::Material& m, bool flip) {
+
+  Bitboard used = 0;
+  uint64_t idx = flip ? ~pos.side_to_move() : pos.side_to_move();
+
+  for (int i = 0; i < m.size; ++i)
+  {
+      Piece pc = flip ? ~m.pieces[i] : m.pieces[i];
+      Square s = lsb(pos.pieces(color_of(pc), type_of(pc)) & ~used);
+      used |= s;
+      idx = idx * 64 + (flip ? ~s : s);
+  }
+
+  return idx;
+}
+
+// strength() orders the sides of a code, more pieces first, then better ones
+std::vector<int> strength(const string& side) {
+
+  std::vector<int> v(1, int(side.size()));
+  for (char c : side)
+      if (c != 'K')
+          v.push_back(-int(PieceOrder.find(c)));
+  return v;
+}
+
+} // namespace
+
+
+/// Material::Material() parses a code like "KRKN", the white pieces first
+
+EGTB::Material::Material(const std::string& c) : code(c) {
+
+  size_t k = code.find('K', 1);
+
+  if (   code.empty() || code[0] != 'K' || k == string::npos
+      || code.find('K', k + 1) != string::npos
+      || code.size() > size_t(MaxPieces))
+      return;
+
+  for (size_t i = 0; i < code.size(); ++i)
+  {
+      size_t pt = string(" PMSNRK").find(code[i]);
+      if (pt == string::npos || pt == 0)
+          return;
+
+      pieces[i] = make_piece(i < k ? WHITE : BLACK, PieceType(pt));
+  }
+
+  size = int(code.size());
+}
+
+
+/// Material::flip() returns the material with white and black swapped
+
+EGTB::Material EGTB::Material::flip() const {
+
+  size_t k = code.find('K', 1);
+  return Material(code.substr(k) + code.substr(0, k));
+}
+
+
+/// canonical() sorts the pieces of each side and puts the stronger one first.
+/// Tables are built only for these codes, the others are probed with the
+/// colors swapped.
+
+std::string EGTB::canonical(const std::string& code) {
+
+  size_t k = code.find('K', 1);
+  if (k == string::npos)
+      return code;
+
+  string sides[] = { code.substr(0, k), code.substr(k) };
+
+  for (string& s : sides)
+      std::sort(s.begin() + 1, s.end(), [](char a, char b) {
+          return PieceOrder.find(a) < PieceOrder.find(b);
+      });
+
+  if (strength(sides[0]) < strength(sides[1]))
+      std::swap(sides[0], sides[1]);
+
+  return sides[0] + sides[1];
+}
+
+
+std::string EGTB::table_name(const std::string& code) {
+  return code + ".mktb";
+}
+
+
+/// all_codes() lists the canonical codes of all the tables with three or more
+/// pieces, up to MaxPieces.
+
+std::vector<std::string> EGTB::all_codes() {
+
+  std::set<string> codes;
+  std::vector<string> sides = { "K" };
+
+  for (int n = 1; n <= MaxPieces - 2; ++n)
+      for (size_t i = 0, end = sides.size(); i < end; ++i)
+          for (char c : PieceOrder)
+              sides.push_back(sides[i] + c);
+
+  for (const string& a : sides)
+      for (const string& b : sides)
+          if (a.size() + b.size() > 2 && a.size() + b.size() <= size_t(MaxPieces))
+              codes.insert(canonical(a + b));
+
+  return std::vector<string>(codes.begin(), codes.end());
+}
+
+
+/// init() maps the table files found in the given directories, separated by
+/// ':' on Unix and by ';' on Windows, as for the Syzygy tables.
+
+void EGTB::init(const std::string& paths) {
+
+  Tables.clear();
+  TableByKey.clear();
+  MaxCardinality = 0;
+
+  if (paths.empty() || paths == "<empty>")
+      return;
+
+#ifndef _WIN32
+  const char SepChar = ':';
+#else
+  const char SepChar = ';';
+#endif
+
+  for (const string& code : all_codes())
+  {
+      std::stringstream ss(paths);
+      string path;
+
+      while (std::getline(ss, path, SepChar))
+      {
+          std::unique_ptr<Table> t(new Table(code));
+
+          if (!(t->data = map_file(path + "/" + table_name(code), t->material)))
+              continue;
+
+          StateInfo st;
+          TableByKey[Position().set(code, WHITE, &st).material_key()] = std::make_pair(t.get(), false);
+          TableByKey[Position().set(code, BLACK, &st).material_key()] = std::make_pair(t.get(), true);
+          MaxCardinality = std::max(MaxCardinality, t->material.size);
+          Tables.push_back(std::move(t));
+          break;
+      }
+  }
+
+  sync_cout << "info string Found " << Tables.size()
+            << " Makruk tablebases (up to 4 men, uncompressed)" << sync_endl;
+}
+
+
+/// probe() looks up the position and returns its value from the point of view
+/// of the side to move, a mate score relative to the given ply, and its bound.
+/// Without pawns a mate that the counting rules do not leave time for is a
+/// draw. The limit is taken from the current counter, but a capture that bares
+/// the king restarts the count, so such a draw is only a bound: a lower one
+/// for the side that mates, an upper one for the other side.
+
+bool EGTB::probe(const Position& pos, int ply, Value& value, Bound& bound) {
+
+  auto it = TableByKey.find(pos.material_key());
+
+  if (it == TableByKey.end())
+      return false;
+
+  const Table* t = it->second.first;
+  uint8_t v = t->data[index(pos, t->material, it->second.second)];
+  bound = BOUND_EXACT;
+
+  if (!v)
+      value = VALUE_DRAW;
+
+  else if (   !pos.count<PAWN>()
+           && distance(v) - 1 > pos.counting_ply() - pos.rule50_count())
+  {
+      value = VALUE_DRAW;
+      bound = is_win(v) ? BOUND_LOWER : BOUND_UPPER;
+  }
+  else
+      value = is_win(v) ? mate_in(ply + distance(v)) : mated_in(ply + distance(v));
+
+  return true;
+}
+
+
+/// root_probe() keeps only the root moves with the best tablebase value. For a
+/// win these are the moves with the shortest mate. It returns false if any of
+/// the positions after the root moves is not in the tables, or has a value
+/// that is only a bound.
+
+bool EGTB::root_probe(Position& pos, Search::RootMoves& rootMoves, Value& score) {
+
+  if (rootMoves.empty() || pos.count<ALL_PIECES>() > MaxCardinality)
+      return false;
+
+  StateInfo st;
+
+  for (auto& m : rootMoves)
+  {
+      Value v;
+      Bound b = BOUND_EXACT;
+      pos.do_move(m.pv[0], st);
+
+      bool found =  pos.count<ALL_PIECES>() == 2 ? (v = VALUE_DRAW, true)
+                  : pos.is_draw(1)               ? (v = VALUE_DRAW, true)
+                  : MoveList<LEGAL>(pos).size()  ? probe(pos, 1, v, b) && b == BOUND_EXACT
+                  : (v = pos.checkers() ? mated_in(1) : VALUE_DRAW, true);
+
+      pos.undo_move(m.pv[0]);
+
+      if (!found)
+          return false;
+
+      m.score = -v;
+  }
+
+  std::stable_sort(rootMoves.begin(), rootMoves.end());
+  score = rootMoves[0].score;
+
+  // Among draws and losses let the search choose, without leaving the class
+  auto keep = [&](const Search::RootMove& m) {
+      return score > VALUE_DRAW ? m.score == score
+           : score == VALUE_DRAW ? m.score == VALUE_DRAW : true;
+  };
+
+  rootMoves.erase(std::stable_partition(rootMoves.begin(), rootMoves.end(), keep), rootMoves.end());
+
+  for (auto& m : rootMoves)
+      m.score = -VALUE_INFINITE;
+
+  return true;
+}
@@ -0,0 +1,85 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EGTB_H_INCLUDED
+#define EGTB_H_INCLUDED
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../search.h"
+#include "../types.h"
+
+class Position;
+
+/// EGTB implements Makruk endgame tablebases, which the Syzygy tables cannot
+/// hold. A table stores for each position of a material configuration, like
+/// "KRKN", the distance to mate in plies, ignoring the counting rules. These
+/// are applied when probing. Tables are built by generate() and memory mapped
+/// by init(). They are limited to 4 men and not compressed, one byte per
+/// position, 32 MB for a 4 men table.
+
+namespace EGTB {
+
+const int MaxPieces = 4; // Kings included
+
+extern int MaxCardinality;
+
+void init(const std::string& paths);
+bool probe(const Position& pos, int ply, Value& value, Bound& bound);
+bool root_probe(Position& pos, Search::RootMoves& rootMoves, Value& score);
+bool generate(const std::string& code, const std::string& dir, std::ostream& log);
+
+
+/// Material describes a table: the material code and, in the order used for
+/// indexing, the pieces of the white side, kings first, then the black ones.
+
+struct Material {
+
+  explicit Material(const std::string& code);
+
+  bool is_ok() const { return size > 0; }
+  uint64_t entries() const { return uint64_t(2) << (6 * size); }
+  Material flip() const;
+
+  std::string code;
+  int size = 0;
+  Piece pieces[MaxPieces];
+};
+
+std::string canonical(const std::string& code);
+std::string table_name(const std::string& code);
+std::vector<std::string> all_codes();
+
+/// Table entries are bytes: zero for draws and illegal positions, otherwise
+/// the distance to mate in plies plus one. An odd distance is a win for the
+/// side to move, an even one a loss (zero when mated).
+
+const int MaxDistance = 254;
+
+inline uint8_t encode(int distance) { return uint8_t(distance + 1); }
+inline int distance(uint8_t v) { return v - 1; }
+inline bool is_win(uint8_t v) { return (v - 1) & 1; }
+
+} // namespace EGTB
+
+#endif // #ifndef EGTB_H_INCLUDED
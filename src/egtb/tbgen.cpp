@@ -0,0 +1,496 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstring>   // For std::memcmp
+#include <fstream>
+#include <map>
+#include <set>
+
+#include "../bitboard.h"
+#include "../misc.h"
+#include "egtb.h"
+
+using std::string;
+
+/// The generator is a retrograde analysis over all the positions of a table.
+/// Positions are indexed as by the prober: the side to move, then a square
+/// for each piece in the order of the material code. Moves leaving the table,
+/// captures and promotions, are resolved first with the smaller tables, which
+/// are generated on demand. Then the positions are finalized by increasing
+/// distance to mate, as in a breadth first search of the game graph walked
+/// backwards from the mates.
+
+namespace {
+
+typedef std::vector<uint8_t> TableData;
+
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint64_t entries;
+  char code[16];
+};
+
+// A piece on the board of the generator
+struct Man {
+  Piece pc;
+  Square sq;
+};
+
+enum Flags : uint8_t { IS_LEGAL = 1, CAN_LOSE = 2 };
+
+std::map<string, TableData> Loaded; // Smaller tables needed by the current one, see generate()
+
+
+// attacks() returns the squares attacked by a piece, see Position::attackers_to()
+
+Bitboard attacks(Piece pc, Square s, Bitboard occupied) {
+
+  Color c = color_of(pc);
+
+  switch (type_of(pc))
+  {
+  case PAWN  : return PawnAttacks[c][s];
+  case BISHOP: return BishopAttacks[c][s];
+  case ROOK  : return attacks_bb<ROOK>(s, occupied);
+  default    : return PseudoAttacks[type_of(pc)][s];
+  }
+}
+
+
+// Board holds a position of a table with 'n' men, decoded from its index
+
+struct Board {
+
+  Board(const EGTB::Material& m) : n(m.size) {
+      for (int i = 0; i < n; ++i)
+          men[i].pc = m.pieces[i];
+  }
+
+  uint64_t index() const {
+      uint64_t idx = stm;
+      for (int i = 0; i < n; ++i)
+          idx = idx * 64 + men[i].sq;
+      return idx;
+  }
+
+  void set(uint64_t idx) {
+      for (int i = n - 1; i >= 0; --i, idx /= 64)
+          men[i].sq = Square(idx % 64);
+      stm = Color(idx);
+  }
+
+  Bitboard pieces() const {
+      Bitboard b = 0;
+      for (int i = 0; i < n; ++i)
+          b |= men[i].sq;
+      return b;
+  }
+
+  Bitboard pieces(Color c) const {
+      Bitboard b = 0;
+      for (int i = 0; i < n; ++i)
+          if (color_of(men[i].pc) == c)
+              b |= men[i].sq;
+      return b;
+  }
+
+  Square king(Color c) const {
+      for (int i = 0; i < n; ++i)
+          if (men[i].pc == make_piece(c, KING))
+              return men[i].sq;
+      return SQ_NONE;
+  }
+
+  // Whether square 's' is attacked by the side 'c', ignoring the man 'skip'
+  bool attacked(Square s, Color c, int skip = -1) const {
+      Bitboard occupied = pieces();
+      for (int i = 0; i < n; ++i)
+          if (   i != skip
+              && color_of(men[i].pc) == c
+              && (attacks(men[i].pc, men[i].sq, occupied) & s))
+              return true;
+      return false;
+  }
+
+  // A position is legal if the men stand on different squares, the pawns
+  // on the ranks they can reach and the side not to move is not in check.
+  bool legal() const {
+      if (popcount(pieces()) != n)
+          return false;
+
+      for (int i = 0; i < n; ++i)
+          if (type_of(men[i].pc) == PAWN)
+          {
+              Rank r = relative_rank(color_of(men[i].pc), men[i].sq);
+              if (r < RANK_3 || r > RANK_5)
+                  return false;
+          }
+
+      return !attacked(king(~stm), stm);
+  }
+
+  int n;
+  Man men[EGTB::MaxPieces];
+  Color stm;
+};
+
+
+// code() returns the material code of the men, white first
+
+string code(const std::vector<Man>& men) {
+
+  string sides[COLOR_NB];
+  for (const Man& m : men)
+      sides[color_of(m.pc)] += " PMSNRK"[type_of(m.pc)];
+
+  for (string& s : sides)
+      std::sort(s.begin(), s.end(), [](char a, char b) {
+          return string("KRNSMP").find(a) < string("KRNSMP").find(b);
+      });
+
+  return sides[WHITE] + sides[BLACK];
+}
+
+
+// probe_loaded() looks up a position in one of the smaller tables. The value
+// is from the point of view of the side to move and zero for draws.
+
+uint8_t probe_loaded(const std::vector<Man>& men, Color stm) {
+
+  if (men.size() == 2)
+      return 0;
+
+  string c = code(men);
+  string cc = EGTB::canonical(c);
+  bool flip = (cc != c);
+  EGTB::Material m(cc);
+
+  uint64_t idx = flip ? ~stm : stm;
+  Bitboard used = 0;
+
+  for (int i = 0; i < m.size; ++i)
+      for (const Man& man : men)
+      {
+          Piece pc = flip ? ~man.pc : man.pc;
+          Square s = flip ? ~man.sq : man.sq;
+
+          if (pc == m.pieces[i] && !(used & s))
+          {
+              used |= s;
+              idx = idx * 64 + s;
+              break;
+          }
+      }
+
+  return Loaded.at(cc)[idx];
+}
+
+
+// children() returns the codes of the tables reached by a capture, a
+// promotion, or both.
+
+std::set<string> children(const EGTB::Material& m) {
+
+  std::set<string> result;
+  std::vector<Man> men;
+
+  for (int i = 0; i < m.size; ++i)
+      men.push_back({ m.pieces[i], SQ_NONE });
+
+  auto add = [&](int promoted, int captured) {
+      std::vector<Man> child;
+      for (int i = 0; i < m.size; ++i)
+          if (i != captured)
+              child.push_back({ i == promoted ? make_piece(color_of(men[i].pc), QUEEN)
+                                              : men[i].pc, SQ_NONE });
+      if (child.size() > 2)
+          result.insert(EGTB::canonical(code(child)));
+  };
+
+  for (int i = 0; i < m.size; ++i)
+  {
+      if (type_of(men[i].pc) != KING)
+          add(-1, i);
+
+      if (type_of(men[i].pc) == PAWN)
+      {
+          add(i, -1);
+
+          for (int j = 0; j < m.size; ++j)
+              if (color_of(men[j].pc) != color_of(men[i].pc) && type_of(men[j].pc) != KING)
+                  add(i, j);
+      }
+  }
+
+  return result;
+}
+
+
+// load() reads a table into memory
+
+bool load(const string& code, const string& dir) {
+
+  EGTB::Material m(code);
+  std::ifstream f(dir + "/" + EGTB::table_name(code), std::ios::binary);
+  Header h;
+  TableData data(m.entries());
+
+  if (   !f.read(reinterpret_cast<char*>(&h), sizeof(h))
+      || std::memcmp(h.magic, "MKTB", 4)
+      || h.entries != m.entries()
+      || !f.read(reinterpret_cast<char*>(data.data()), data.size()))
+      return false;
+
+  Loaded[code] = std::move(data);
+  return true;
+}
+
+
+// save() writes a table with the same layout as mapped by the prober
+
+bool save(const EGTB::Material& m, const TableData& data, const string& dir) {
+
+  std::ofstream f(dir + "/" + EGTB::table_name(m.code), std::ios::binary);
+  Header h = { { 'M', 'K', 'T', 'B' }, 1, m.entries(), {} };
+  m.code.copy(h.code, sizeof(h.code) - 1);
+
+  return   f.write(reinterpret_cast<const char*>(&h), sizeof(h))
+        && f.write(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+} // namespace
+
+
+namespace EGTB {
+namespace {
+
+// build() builds a table as generate() does, and keeps in Loaded the tables it
+// loads, for the tables depending on it.
+
+bool build(const std::string& code, const std::string& dir, std::ostream& log) {
+
+  Material m(canonical(code));
+
+  if (!m.is_ok() || m.size < 3)
+  {
+      log << "Invalid material " << code << std::endl;
+      return false;
+  }
+
+  for (const string& c : children(m))
+      if (!load(c, dir) && (!build(c, dir, log) || !load(c, dir)))
+          return false;
+
+  TimePoint elapsed = now();
+  uint64_t size = m.entries();
+  TableData result(size), remaining(size), flags(size), lossPly(size), winPly(size);
+  std::vector<std::vector<uint32_t>> buckets(MaxDistance + 2);
+  Board b(m);
+
+  // Resolve the moves leaving the table and count the other ones
+  for (uint64_t idx = 0; idx < size; ++idx)
+  {
+      b.set(idx);
+
+      if (!b.legal())
+          continue;
+
+      Color us = b.stm;
+      Bitboard occupied = b.pieces(), own = b.pieces(us);
+      int moves = 0, exitWin = MaxDistance + 1;
+      flags[idx] = IS_LEGAL | CAN_LOSE;
+
+      for (int i = 0; i < b.n; ++i)
+      {
+          if (color_of(b.men[i].pc) != us)
+              continue;
+
+          Square from = b.men[i].sq;
+          bool isPawn = type_of(b.men[i].pc) == PAWN;
+          Bitboard targets = attacks(b.men[i].pc, from, occupied) & ~own;
+
+          if (isPawn)
+              targets = (targets & occupied) | (SquareBB[from + pawn_push(us)] & ~occupied);
+
+          while (targets)
+          {
+              Square to = pop_lsb(&targets);
+              Board child = b;
+              int captured = -1;
+
+              for (int j = 0; j < b.n; ++j)
+                  if (b.men[j].sq == to)
+                      captured = j;
+
+              child.men[i].sq = to;
+              child.stm = ~us;
+
+              if (child.attacked(child.king(us), ~us, captured))
+                  continue;
+
+              ++moves;
+
+              if (captured != -1 || (isPawn && relative_rank(us, to) == RANK_6))
+              {
+                  std::vector<Man> men;
+                  for (int j = 0; j < b.n; ++j)
+                      if (j != captured)
+                          men.push_back(child.men[j]);
+
+                  if (isPawn && relative_rank(us, to) == RANK_6)
+                      for (Man& x : men)
+                          if (x.sq == to)
+                              x.pc = make_piece(us, QUEEN);
+
+                  uint8_t v = probe_loaded(men, ~us);
+
+                  if (!v)
+                      flags[idx] &= ~CAN_LOSE;
+                  else if (is_win(v))
+                      lossPly[idx] = uint8_t(std::max(int(lossPly[idx]), std::min(distance(v) + 1, MaxDistance + 1)));
+                  else
+                  {
+                      flags[idx] &= ~CAN_LOSE;
+                      exitWin = std::min(exitWin, distance(v) + 1);
+                  }
+              }
+              else
+                  ++remaining[idx];
+          }
+      }
+
+      if (!moves)
+      {
+          if (b.attacked(b.king(us), ~us))
+              buckets[0].push_back(uint32_t(idx));
+      }
+      else if (exitWin <= MaxDistance)
+      {
+          winPly[idx] = uint8_t(exitWin);
+          buckets[exitWin].push_back(uint32_t(idx));
+      }
+      else if (!remaining[idx] && (flags[idx] & CAN_LOSE))
+          buckets[lossPly[idx]].push_back(uint32_t(idx));
+  }
+
+  // Finalize the positions by increasing distance and push their predecessors
+  uint64_t wins = 0, losses = 0;
+  int longest = 0;
+
+  for (int d = 0; d <= MaxDistance + 1; ++d)
+  {
+      std::vector<uint32_t> bucket;
+      bucket.swap(buckets[d]);
+
+      for (uint32_t idx : bucket)
+      {
+          if (result[idx])
+              continue;
+
+          if (d > MaxDistance)
+          {
+              log << m.code << ": distance to mate above " << MaxDistance << std::endl;
+              return false;
+          }
+
+          result[idx] = encode(d);
+          (d & 1 ? wins : losses)++;
+          longest = d;
+
+          b.set(idx);
+          Color them = ~b.stm;
+          Bitboard occupied = b.pieces();
+
+          // Take back the moves of the side that just moved, captures and
+          // promotions excluded as they come from other tables.
+          for (int i = 0; i < b.n; ++i)
+          {
+              if (color_of(b.men[i].pc) != them)
+                  continue;
+
+              Square to = b.men[i].sq;
+              PieceType pt = type_of(b.men[i].pc);
+              Bitboard origins =  pt == PAWN   ? SquareBB[to - pawn_push(them)]
+                                : pt == BISHOP ? BishopAttacks[~them][to]
+                                : attacks(b.men[i].pc, to, occupied);
+
+              if (pt == PAWN && relative_rank(them, to) <= RANK_3)
+                  origins = 0;
+
+              origins &= ~occupied;
+
+              while (origins)
+              {
+                  Board prev = b;
+                  prev.men[i].sq = pop_lsb(&origins);
+                  prev.stm = them;
+                  uint64_t q = prev.index();
+
+                  if (!(flags[q] & IS_LEGAL) || result[q])
+                      continue;
+
+                  if (d & 1)
+                  {
+                      // The position just finalized is a win for the opponent
+                      lossPly[q] = uint8_t(std::max(int(lossPly[q]), d + 1));
+
+                      if (!--remaining[q] && (flags[q] & CAN_LOSE))
+                          buckets[lossPly[q]].push_back(uint32_t(q));
+                  }
+                  else if (!winPly[q] || winPly[q] > d + 1)
+                  {
+                      winPly[q] = uint8_t(d + 1);
+                      buckets[d + 1].push_back(uint32_t(q));
+                  }
+              }
+          }
+      }
+  }
+
+  if (!save(m, result, dir))
+  {
+      log << "Cannot write " << dir << "/" << table_name(m.code) << std::endl;
+      return false;
+  }
+
+  Loaded[m.code] = std::move(result);
+
+  log << m.code << ": " << wins << " wins, " << losses << " losses, longest mate "
+      << longest << " plies, " << now() - elapsed << " ms" << std::endl;
+
+  return true;
+}
+
+} // namespace
+} // namespace EGTB
+
+
+/// generate() builds the table of the given material code in directory 'dir',
+/// generating first the missing tables it depends on. Progress and a summary
+/// are written to 'log'. The tables loaded are freed when done.
+
+bool EGTB::generate(const std::string& code, const std::string& dir, std::ostream& log) {
+
+  bool ok = build(code, dir, log);
+  Loaded.clear();
+  return ok;
+}
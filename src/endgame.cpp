@@ -24,7 +24,6 @@
 #include "bitboard.h"
 #include "endgame.h"
 #include "movegen.h"
-#include "uci.h"
 
 using std::string;
 
@@ -84,9 +83,14 @@ namespace {
 
 /// Endgames members definitions
 
-Endgames::Endgames() {
+std::pair<Endgames::Table<Value>, Endgames::Table<ScaleFactor>> Endgames::tables;
+
+void Endgames::init() {
 
   add<KNNK>("KNNK");
+  add<KQK>("KMK");
+  add<KBK>("KSK");
+  add<KNK>("KNK");
   add<KBNK>("KSNK");
   add<KBQK>("KSMK");
   add<KNQK>("KNMK");
@@ -130,7 +134,7 @@ Value Endgame<KXK>::operator()(const Position& pos) const {
 
   if (pos.count<ALL_PIECES>(weakSide) == 1)
   {
-      if (!pos.count<PAWN>() && Options["EnableCounting"])
+      if (!pos.count<PAWN>() && EnableCounting)
           result = result * std::max(2 * pos.counting_limit() - pos.rule50_count(), 0) / 128;
       else if (   pos.count<  ROOK>(strongSide)
               || pos.count<BISHOP>(strongSide) >= 2
@@ -329,8 +333,12 @@ Value Endgame<KRKQ>::operator()(const Position& pos) const {
 }
 
 
-/// Some cases of trivial draws
+/// Some cases of trivial draws. A single Met, Khon or knight cannot force mate,
+/// whatever is left of the count.
 template<> Value Endgame<KNNK>::operator()(const Position&) const { return VALUE_DRAW; }
+template<> Value Endgame<KQK>::operator()(const Position&) const { return VALUE_DRAW; }
+template<> Value Endgame<KBK>::operator()(const Position&) const { return VALUE_DRAW; }
+template<> Value Endgame<KNK>::operator()(const Position&) const { return VALUE_DRAW; }
 
 
 /// KRP vs KR.
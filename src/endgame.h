@@ -21,7 +21,7 @@
 #ifndef ENDGAME_H_INCLUDED
 #define ENDGAME_H_INCLUDED
 
-#include <map>
+#include <array>
 #include <memory>
 #include <string>
 #include <type_traits>
@@ -47,6 +47,9 @@ enum EndgameCode {
   KRKN,  // KR vs KN
   KQKP,  // KQ vs KP
   KRKQ,  // KQ vs KR
+  KQK,   // KQ vs K
+  KBK,   // KB vs K
+  KNK,   // KN vs K
 
   SCALING_FUNCTIONS,
   KRPKR,   // KRP vs KR
@@ -87,37 +90,55 @@ struct Endgame : public EndgameBase<T> {
 };
 
 
-/// The Endgames class stores the pointers to endgame evaluation and scaling
-/// base objects in two std::map. We use polymorphism to invoke the actual
+/// The Endgames namespace stores the pointers to endgame evaluation and
+/// scaling base objects in two flat tables indexed by material key, with
+/// linear probing. They are filled once by init() and then only read, so
+/// that all threads share them. We use polymorphism to invoke the actual
 /// endgame function by calling its virtual operator().
 
-class Endgames {
+namespace Endgames {
+
+  const size_t TableSize = 64; // Power of 2, at least twice the number of keys
 
   template<typename T> using Ptr = std::unique_ptr<EndgameBase<T>>;
-  template<typename T> using Map = std::map<Key, Ptr<T>>;
+  template<typename T> struct Slot { Key key; Ptr<T> function; };
+  template<typename T> using Table = std::array<Slot<T>, TableSize>;
+
+  extern std::pair<Table<Value>, Table<ScaleFactor>> tables;
 
   template<typename T>
-  Map<T>& map() {
-    return std::get<std::is_same<T, ScaleFactor>::value>(maps);
+  Table<T>& table() {
+    return std::get<std::is_same<T, ScaleFactor>::value>(tables);
   }
 
   template<EndgameCode E, typename T = eg_type<E>, typename P = Ptr<T>>
   void add(const std::string& code) {
 
     StateInfo st;
-    map<T>()[Position().set(code, WHITE, &st).material_key()] = P(new Endgame<E>(WHITE));
-    map<T>()[Position().set(code, BLACK, &st).material_key()] = P(new Endgame<E>(BLACK));
-  }
 
-  std::pair<Map<Value>, Map<ScaleFactor>> maps;
+    for (Color c = WHITE; c <= BLACK; ++c)
+    {
+        Key key = Position().set(code, c, &st).material_key();
+        size_t i = key & (TableSize - 1);
 
-public:
-  Endgames();
+        while (table<T>()[i].function && table<T>()[i].key != key)
+            i = (i + 1) & (TableSize - 1);
+
+        table<T>()[i] = { key, P(new Endgame<E>(c)) };
+    }
+  }
+
+  void init();
 
   template<typename T>
-  EndgameBase<T>* probe(Key key) {
-    return map<T>().count(key) ? map<T>()[key].get() : nullptr;
+  inline EndgameBase<T>* probe(Key key) {
+
+    for (size_t i = key & (TableSize - 1); table<T>()[i].function; i = (i + 1) & (TableSize - 1))
+        if (table<T>()[i].key == key)
+            return table<T>()[i].function.get();
+
+    return nullptr;
   }
-};
+}
 
 #endif // #ifndef ENDGAME_H_INCLUDED
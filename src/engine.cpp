@@ -0,0 +1,99 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bitboard.h"
+#include "cluster.h"
+#include "endgame.h"
+#include "engine.h"
+#include "pawns.h"
+#include "egtb/egtb.h"
+#include "syzygy/tbprobe.h"
+
+namespace PSQT {
+  void init();
+}
+
+thread_local Engine* Engine::CurrentEngine = nullptr;
+
+
+/// Engine::init() computes the tables shared by all the instances. It must be
+/// called once, before the first instance is created.
+
+void Engine::init() {
+
+  PSQT::init();
+  Bitboards::init();
+  Position::init();
+  Endgames::init();
+  Search::init();
+  Pawns::init();
+  Tablebases::init("<empty>");
+}
+
+
+/// Engine constructor sets up the options to their default values, the hash
+/// table and the threads, that stay parked until a search starts.
+
+Engine::Engine(std::ostream& os) : search(Search::new_state()), out(os), states(1) {
+
+  Scope scope(this);
+
+  UCI::init(options);
+  tt.resize(options["Hash"]);
+  threads.set(options["Threads"]);
+  Search::clear(); // After threads are up
+
+  uiThread.reset(new Thread(0));
+  pos.set(UCI::StartFEN, false, &states.back(), uiThread.get());
+}
+
+
+/// Engine destructor stops a running search and waits for the threads to exit
+
+Engine::~Engine() {
+
+  Scope scope(this);
+
+  Cluster::detach(this);
+  threads.stop = true;
+  threads.set(0);
+  uiThread.reset();
+  flush_output(out); // Before the stream goes away
+}
+
+
+/// Engine::command() executes a UCI command, or one of our debugging commands,
+/// in this instance. Output goes to the stream given to the constructor. It
+/// returns false on 'quit'.
+
+bool Engine::command(const std::string& cmd) {
+
+  Scope scope(this);
+
+  return UCI::command(cmd);
+}
+
+
+/// output() is the stream of the engine of the calling thread, if any
+
+std::ostream& output() {
+
+  return Engine::CurrentEngine ? Engine::CurrentEngine->out : std::cout;
+}
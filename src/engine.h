@@ -0,0 +1,88 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENGINE_H_INCLUDED
+#define ENGINE_H_INCLUDED
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "position.h"
+#include "search.h"
+#include "thread.h"
+#include "timeman.h"
+#include "tt.h"
+#include "uci.h"
+
+/// Engine is an instance of the engine, with its own options, transposition
+/// table, threads and search state, so that a process can play several games
+/// at once. The tables computed by Engine::init() (bitboards, PSQT, endgames,
+/// tablebases) are read-only and shared by all the instances, as are the shared
+/// pawn and material caches. A few options change process-wide settings: the
+/// tablebase paths, "Lazy Threshold", "EnableCounting", "Shared Eval Cache" and
+/// the cluster options. They are meant to be set alike in all the instances,
+/// while none of them is searching, and only one instance can use a cluster.
+///
+/// The output is written to the stream by the output thread, see sync_cout, so
+/// call flush_output() before reading a stream written by an instance.
+///
+/// Code refers to its instance through CurrentEngine, a pointer private to each
+/// thread: command() sets it for the calling thread and the search threads set
+/// it to the instance that created them. The engine sources name the members
+/// of the current instance through the macros of globals.h.
+
+class Engine {
+public:
+  static void init();
+
+  explicit Engine(std::ostream& os = std::cout);
+  ~Engine();
+  Engine(const Engine&) = delete;
+  Engine& operator=(const Engine&) = delete;
+
+  bool command(const std::string& cmd);
+
+  UCI::OptionsMap options;
+  TranspositionTable tt;
+  ThreadPool threads;
+  Search::LimitsType limits;
+  TimeManagement time;
+  std::shared_ptr<Search::State> search;
+  std::ostream& out;
+
+  // Game state of the UCI commands
+  Position pos;
+  StateList states;
+  std::string positionCmd = "position startpos";
+  std::unique_ptr<Thread> uiThread;
+
+  /// Scope makes an instance the current one of the calling thread, until
+  /// the end of the scope.
+  struct Scope {
+    explicit Scope(Engine* e) : previous(CurrentEngine) { CurrentEngine = e; }
+    ~Scope() { CurrentEngine = previous; }
+    Engine* previous;
+  };
+
+  static thread_local Engine* CurrentEngine;
+};
+
+#endif // #ifndef ENGINE_H_INCLUDED
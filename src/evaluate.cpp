@@ -28,6 +28,7 @@
 #include "evaluate.h"
 #include "material.h"
 #include "pawns.h"
+#include "profile.h"
 
 namespace {
 
@@ -231,7 +232,7 @@ namespace {
   const int BishopCheck = 435;
   const int KnightCheck = 790;
 
-  // Threshold for lazy and space evaluation
+  // Threshold for space evaluation
   const Value SpaceThreshold = Value(12222);
 
 
@@ -290,7 +291,11 @@ namespace {
     Square s;
     Score score = SCORE_ZERO;
 
-    attackedBy[Us][Pt] = 0;
+    // The attacks of the step pieces are kept up to date by do_move(), they
+    // are computed here only for rooks and when one of the pieces is pinned.
+    bool incremental = Pt != ROOK && !(pos.pinned_pieces(Us) & pos.pieces(Us, Pt));
+
+    attackedBy[Us][Pt] = incremental ? pos.attacks_by(Us, Pt) : 0;
 
     while ((s = *pl++) != SQ_NONE)
     {
@@ -303,7 +308,10 @@ namespace {
             b &= LineBB[pos.square<KING>(Us)][s];
 
         attackedBy2[Us] |= attackedBy[Us][ALL_PIECES] & b;
-        attackedBy[Us][ALL_PIECES] |= attackedBy[Us][Pt] |= b;
+        attackedBy[Us][ALL_PIECES] |= b;
+
+        if (!incremental)
+            attackedBy[Us][Pt] |= b;
 
         if (b & kingRing[Them])
         {
@@ -779,6 +787,15 @@ namespace {
     pe = Pawns::probe(pos);
     score += pe->pawns_score();
 
+    // Early exit if the cheap terms are already far from a balanced position,
+    // the mobility, king safety and threat terms are then skipped.
+    if (!T && Eval::LazyThreshold)
+    {
+        Value v = (mg_value(score) + eg_value(score)) / 2;
+        if (abs(v) > Eval::LazyThreshold)
+            return pos.side_to_move() == WHITE ? v : -v;
+    }
+
     // Main evaluation begins here
 
     initialize<WHITE>();
@@ -832,11 +849,15 @@ namespace {
 } // namespace
 
 
+Value Eval::LazyThreshold = VALUE_ZERO;
+
+
 /// evaluate() is the evaluator for the outer world. It returns a static evaluation
 /// of the position from the point of view of the side to move.
 
-Value Eval::evaluate(const Position& pos)
+HOT_CLONES Value Eval::evaluate(const Position& pos)
 {
+   PROFILE_SCOPE(EVALUATE);
    return Evaluation<>(pos).value();
 }
 
@@ -31,6 +31,8 @@ namespace Eval {
 
 const Value Tempo = Value(20); // Must be visible to search
 
+extern Value LazyThreshold; // Set by the "Lazy Threshold" UCI option, zero is off
+
 std::string trace(const Position& pos);
 
 Value evaluate(const Position& pos);
@@ -0,0 +1,51 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GLOBALS_H_INCLUDED
+#define GLOBALS_H_INCLUDED
+
+#include "engine.h"
+
+/// TT, Threads, Options, Limits and Time name the members of the current
+/// instance, see Engine::CurrentEngine. It is set by Engine::command() and on
+/// the threads of an instance only: a thread of the application, or a helper
+/// thread, must open an Engine::Scope first. current() asserts it. The header
+/// is internal to the engine sources, an application embedding the library
+/// includes engine.h only.
+///
+/// The instances still share the process-wide state:
+///  - EnableCounting and Eval::LazyThreshold, set by their options
+///  - the Syzygy and Makruk tablebases, loaded from SyzygyPath and MakrukTBPath
+///  - the shared pawn and material caches of "Shared Eval Cache"
+///  - the cluster connection, the one of a single instance, and its options
+///  - the debug log file and the output thread
+
+inline Engine& current() {
+  assert(Engine::CurrentEngine && "No engine set for this thread, see Engine::Scope");
+  return *Engine::CurrentEngine;
+}
+
+#define TT      (current().tt)
+#define Threads (current().threads)
+#define Options (current().options)
+#define Limits  (current().limits)
+#define Time    (current().time)
+
+#endif // #ifndef GLOBALS_H_INCLUDED
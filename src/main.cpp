@@ -20,36 +20,21 @@
 
 #include <iostream>
 
-#include "bitboard.h"
-#include "position.h"
-#include "search.h"
-#include "thread.h"
-#include "tt.h"
+#include "engine.h"
+#include "misc.h"
 #include "uci.h"
-#include "syzygy/tbprobe.h"
-
-namespace PSQT {
-  void init();
-}
 
 int main(int argc, char* argv[]) {
 
+  TimePoint start = now();
+
   std::cout << engine_info() << std::endl;
 
-  UCI::init(Options);
-  PSQT::init();
-  Bitboards::init();
-  Position::init();
-  Bitbases::init();
-  Search::init();
-  Pawns::init();
-  Tablebases::init(Options["SyzygyPath"]);
-  TT.resize(Options["Hash"]);
-  Threads.init(Options["Threads"]);
-  Search::clear(); // After threads are up
-
-  UCI::loop(argc, argv);
-
-  Threads.exit();
+  Engine::init();
+  Engine engine;
+  StartupTime = now() - start;
+
+  UCI::loop(engine, argc, argv);
+
   return 0;
 }
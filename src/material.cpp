@@ -106,83 +106,121 @@ namespace {
 
 namespace Material {
 
+SharedTable Shared; // Optional table shared by all threads
+
+namespace {
+
+  /// compute() fills a new Entry for the position's material configuration
+
+  Entry* compute(const Position& pos, Entry* e) {
+
+    Key key = pos.material_key();
+
+    std::memset(e, 0, sizeof(Entry));
+    e->key = key;
+    e->factor[WHITE] = e->factor[BLACK] = (uint8_t)SCALE_FACTOR_NORMAL;
+
+    Value npm_w = pos.non_pawn_material(WHITE);
+    Value npm_b = pos.non_pawn_material(BLACK);
+    Value npm = std::max(EndgameLimit, std::min(npm_w + npm_b, MidgameLimit));
+
+    // Map total non-pawn material into [PHASE_ENDGAME, PHASE_MIDGAME]
+    e->gamePhase = Phase(((npm - EndgameLimit) * PHASE_MIDGAME) / (MidgameLimit - EndgameLimit));
+
+    // Let's look if we have a specialized evaluation function for this particular
+    // material configuration. Firstly we look for a fixed configuration one, then
+    // for a generic one if the previous search failed.
+    if ((e->evaluationFunction = Endgames::probe<Value>(key)) != nullptr)
+        return e;
+
+    // Only queens and pawns against bare king
+    for (Color c = WHITE; c <= BLACK; ++c)
+        if (is_KQsPsK(pos, c))
+        {
+            e->evaluationFunction = &EvaluateKQsPsK[c];
+            return e;
+        }
+
+    // All other KXK situations
+    for (Color c = WHITE; c <= BLACK; ++c)
+        if (is_KXK(pos, c))
+        {
+            e->evaluationFunction = &EvaluateKXK[c];
+            return e;
+        }
+
+    // OK, we didn't find any special evaluation function for the current material
+    // configuration. Is there a suitable specialized scaling function?
+    EndgameBase<ScaleFactor>* sf;
+
+    if ((sf = Endgames::probe<ScaleFactor>(key)) != nullptr)
+    {
+        e->scalingFunction[sf->strongSide] = sf; // Only strong color assigned
+        return e;
+    }
+
+    // A small material advantage makes it difficult to win.
+    // This catches some trivial draws like KK, KBK and KNK and gives a
+    // drawish scale factor for cases such as KRKBP and KmmKm (except for KBBKN).
+    if (npm_w + pos.count<PAWN>(WHITE) * QueenValueEg - npm_b <= KnightValueMg)
+        e->factor[WHITE] = uint8_t(npm_w + pos.count<PAWN>(WHITE) * QueenValueEg <= KnightValueMg ? SCALE_FACTOR_DRAW :
+                                   npm_b <= BishopValueMg ? 4 : 14);
+
+    if (npm_b + pos.count<PAWN>(BLACK) * QueenValueEg - npm_w <= KnightValueMg)
+        e->factor[BLACK] = uint8_t(npm_b + pos.count<PAWN>(BLACK) * QueenValueEg <= KnightValueMg ? SCALE_FACTOR_DRAW :
+                                   npm_w <= BishopValueMg ? 4 : 14);
+
+    // Evaluate the material imbalance. We use PIECE_TYPE_NONE as a place holder
+    // for the bishop pair "extended piece", which allows us to be more flexible
+    // in defining bishop pair bonuses.
+    const int PieceCount[COLOR_NB][PIECE_TYPE_NB] = {
+    { pos.queen_pair(WHITE), pos.count<PAWN>(WHITE), pos.count<QUEEN >(WHITE),
+      pos.count<BISHOP>(WHITE), pos.count<KNIGHT>(WHITE), pos.count<ROOK>(WHITE) },
+    { pos.queen_pair(BLACK), pos.count<PAWN>(BLACK), pos.count<QUEEN >(BLACK),
+      pos.count<BISHOP>(BLACK), pos.count<KNIGHT>(BLACK), pos.count<ROOK>(BLACK) } };
+
+    e->value = int16_t((imbalance<WHITE>(PieceCount) - imbalance<BLACK>(PieceCount)) / 16);
+    return e;
+  }
+
+} // namespace
+
+
 /// Material::probe() looks up the current position's material configuration in
 /// the material hash table. It returns a pointer to the Entry if the position
-/// is found. Otherwise a new Entry is computed and stored there, so we don't
-/// have to recompute all when the same material configuration occurs again.
+/// is found. Otherwise the entry is copied from the shared table, if enabled,
+/// or a new Entry is computed and stored there, so we don't have to recompute
+/// all when the same material configuration occurs again.
 
 Entry* probe(const Position& pos) {
 
   Key key = pos.material_key();
-  Entry* e = pos.this_thread()->materialTable[key];
+  Thread* th = pos.this_thread();
+  Entry* e = th->materialTable[key];
+
+  STATS_INC(MATERIAL_PROBE);
 
   if (e->key == key)
-      return e;
-
-  std::memset(e, 0, sizeof(Entry));
-  e->key = key;
-  e->factor[WHITE] = e->factor[BLACK] = (uint8_t)SCALE_FACTOR_NORMAL;
-
-  Value npm_w = pos.non_pawn_material(WHITE);
-  Value npm_b = pos.non_pawn_material(BLACK);
-  Value npm = std::max(EndgameLimit, std::min(npm_w + npm_b, MidgameLimit));
-
-  // Map total non-pawn material into [PHASE_ENDGAME, PHASE_MIDGAME]
-  e->gamePhase = Phase(((npm - EndgameLimit) * PHASE_MIDGAME) / (MidgameLimit - EndgameLimit));
-
-  // Let's look if we have a specialized evaluation function for this particular
-  // material configuration. Firstly we look for a fixed configuration one, then
-  // for a generic one if the previous search failed.
-  if ((e->evaluationFunction = pos.this_thread()->endgames.probe<Value>(key)) != nullptr)
-      return e;
-
-  // Only queens and pawns against bare king
-  for (Color c = WHITE; c <= BLACK; ++c)
-      if (is_KQsPsK(pos, c))
-      {
-          e->evaluationFunction = &EvaluateKQsPsK[c];
-          return e;
-      }
-
-  // All other KXK situations
-  for (Color c = WHITE; c <= BLACK; ++c)
-      if (is_KXK(pos, c))
-      {
-          e->evaluationFunction = &EvaluateKXK[c];
-          return e;
-      }
-
-  // OK, we didn't find any special evaluation function for the current material
-  // configuration. Is there a suitable specialized scaling function?
-  EndgameBase<ScaleFactor>* sf;
-
-  if ((sf = pos.this_thread()->endgames.probe<ScaleFactor>(key)) != nullptr)
   {
-      e->scalingFunction[sf->strongSide] = sf; // Only strong color assigned
-      return e;
+      STATS_INC(MATERIAL_HIT);
+      return ++th->materialTable.hits, e;
   }
 
-  // A small material advantage makes it difficult to win.
-  // This catches some trivial draws like KK, KBK and KNK and gives a
-  // drawish scale factor for cases such as KRKBP and KmmKm (except for KBBKN).
-  if (npm_w + pos.count<PAWN>(WHITE) * QueenValueEg - npm_b <= KnightValueMg)
-      e->factor[WHITE] = uint8_t(npm_w + pos.count<PAWN>(WHITE) * QueenValueEg <= KnightValueMg ? SCALE_FACTOR_DRAW :
-                                 npm_b <= BishopValueMg ? 4 : 14);
-
-  if (npm_b + pos.count<PAWN>(BLACK) * QueenValueEg - npm_w <= KnightValueMg)
-      e->factor[BLACK] = uint8_t(npm_b + pos.count<PAWN>(BLACK) * QueenValueEg <= KnightValueMg ? SCALE_FACTOR_DRAW :
-                                 npm_w <= BishopValueMg ? 4 : 14);
-
-  // Evaluate the material imbalance. We use PIECE_TYPE_NONE as a place holder
-  // for the bishop pair "extended piece", which allows us to be more flexible
-  // in defining bishop pair bonuses.
-  const int PieceCount[COLOR_NB][PIECE_TYPE_NB] = {
-  { pos.queen_pair(WHITE), pos.count<PAWN>(WHITE), pos.count<QUEEN >(WHITE),
-    pos.count<BISHOP>(WHITE), pos.count<KNIGHT>(WHITE), pos.count<ROOK>(WHITE) },
-  { pos.queen_pair(BLACK), pos.count<PAWN>(BLACK), pos.count<QUEEN >(BLACK),
-    pos.count<BISHOP>(BLACK), pos.count<KNIGHT>(BLACK), pos.count<ROOK>(BLACK) } };
-
-  e->value = int16_t((imbalance<WHITE>(PieceCount) - imbalance<BLACK>(PieceCount)) / 16);
+  ++th->materialTable.misses;
+
+  if (Shared.enabled())
+  {
+      ++th->sharedProbes;
+
+      if (Shared.probe(key, e))
+          return ++th->sharedHits, e;
+  }
+
+  compute(pos, e);
+
+  if (Shared.enabled())
+      Shared.store(*e);
+
   return e;
 }
 
@@ -64,7 +64,10 @@ struct Entry {
   Phase gamePhase;
 };
 
-typedef HashTable<Entry, 8192> Table;
+typedef HashTable<Entry> Table;
+typedef SharedHashTable<Entry> SharedTable;
+
+extern SharedTable Shared;
 
 Entry* probe(const Position& pos);
 
@@ -36,14 +36,29 @@ typedef bool(*fun3_t)(HANDLE, CONST GROUP_AFFINITY*, PGROUP_AFFINITY);
 }
 #endif
 
+#if defined(__linux__)
+#include <dirent.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <map>
 #include <sstream>
+#include <thread>
 #include <vector>
 
+#include "globals.h"
 #include "misc.h"
 #include "thread.h"
+#include "uci.h"
 
 using namespace std;
 
@@ -53,6 +68,121 @@ namespace {
 /// DD-MM-YY and show in engine_info.
 const string Version = "";
 
+/// OutputQueue holds the lines written with sync_cout, until the output thread
+/// writes them to their stream, so that a slow GUI pipe or log file does not
+/// stall the search. A line updating the PV of an index, or the current move,
+/// replaces a queued update of the same kind, so that when the reader does not
+/// keep up with the search it gets the latest information only.
+
+class OutputQueue {
+
+  struct Line {
+    std::ostream* os;
+    string text, kind; // Empty kind if the line cannot be replaced
+  };
+
+public:
+  OutputQueue() : thread(&OutputQueue::loop, this) {}
+ ~OutputQueue() {
+    {
+        std::lock_guard<Mutex> lk(mutex);
+        exit = true;
+        cv.notify_all();
+    }
+    thread.join();
+  }
+
+  void push(std::ostream* os, string&& text) {
+
+    string kind;
+    size_t pos;
+
+    if (text.compare(0, 5, "info ") == 0)
+    {
+        if (text.find(" currmove ") != string::npos)
+            kind = "currmove";
+
+        else if ((pos = text.find(" multipv ")) != string::npos)
+            kind = text.substr(pos, text.find(' ', pos + 9) - pos);
+    }
+
+    std::lock_guard<Mutex> lk(mutex);
+
+    // Look for a line to replace among the last info lines
+    if (!kind.empty())
+        for (auto it = lines.rbegin(); it != lines.rend() && it->text.compare(0, 5, "info ") == 0; ++it)
+            if (it->os == os && it->kind == kind)
+            {
+                lines.erase(std::next(it).base());
+                --pending[os];
+                break;
+            }
+
+    lines.push_back({ os, std::move(text), std::move(kind) });
+    ++pending[os];
+    cv.notify_all();
+  }
+
+  // flush() waits until the queued lines of the given stream are written, the
+  // lines of the other streams, maybe of other engines, are not waited for.
+  void flush(const std::ostream* os) {
+    std::unique_lock<Mutex> lk(mutex);
+    cv.wait(lk, [&]{ return !pending.count(os); });
+  }
+
+  Mutex writeMutex; // Held while writing, to change a stream buffer safely
+
+private:
+  void loop() {
+
+    std::unique_lock<Mutex> lk(mutex);
+
+    while (true)
+    {
+        cv.wait(lk, [&]{ return exit || !lines.empty(); });
+
+        if (lines.empty())
+            break; // Exit, after writing all the lines
+
+        std::deque<Line> batch;
+        std::swap(batch, lines);
+        lk.unlock();
+
+        {
+            std::lock_guard<Mutex> wlk(writeMutex);
+
+            for (Line& l : batch)
+                *l.os << l.text;
+
+            for (Line& l : batch)
+                l.os->flush();
+        }
+
+        lk.lock();
+        for (Line& l : batch)
+            if (!--pending[l.os])
+                pending.erase(l.os);
+        cv.notify_all();
+    }
+  }
+
+  Mutex mutex;
+  ConditionVariable cv;
+  std::deque<Line> lines;
+  std::map<const std::ostream*, int> pending; // Lines queued or being written
+  bool exit = false;
+  std::thread thread;
+};
+
+OutputQueue& output_queue() {
+  static OutputQueue q; // Started at the first line, stopped at exit
+  return q;
+}
+
+thread_local std::ostringstream LineBuf; // The line being written by a thread
+thread_local std::ostream* LineStream;
+
+
 /// Our fancy logging facility. The trick here is to replace cin.rdbuf() and
 /// cout.rdbuf() with two Tie objects that tie cin and cout to a file stream. We
 /// can toggle the logging of std::cout and std:cin at runtime whilst preserving
@@ -63,27 +193,66 @@ struct Tie: public streambuf { // MSVC requires split streambuf for cin and cout
 
   Tie(streambuf* b, streambuf* l) : buf(b), logBuf(l) {}
 
-  int sync() override { return logBuf->pubsync(), buf->pubsync(); }
+  int sync() override { return log_sync(), buf->pubsync(); }
   int overflow(int c) override { return log(buf->sputc((char)c), "<< "); }
   int underflow() override { return buf->sgetc(); }
   int uflow() override { return log(buf->sbumpc(), ">> "); }
 
+  // The output thread writes whole lines, logged at once
+  std::streamsize xsputn(const char* s, std::streamsize n) override {
+    n = buf->sputn(s, n);
+    std::lock_guard<Mutex> lk(log_mutex());
+    write_log(s, n, "<< ");
+    return n;
+  }
+
   streambuf *buf, *logBuf;
 
+  // The log is written by the UCI thread reading cin and by the output thread
+  static Mutex& log_mutex() { static Mutex m; return m; }
+
+  int log_sync() {
+    std::lock_guard<Mutex> lk(log_mutex());
+    return logBuf->pubsync();
+  }
+
   int log(int c, const char* prefix) {
 
-    static int last = '\n'; // Single log file
+    if (c != EOF)
+    {
+        char ch = (char)c;
+        std::lock_guard<Mutex> lk(log_mutex());
+        write_log(&ch, 1, prefix);
+    }
+    return c;
+  }
+
+  // write_log() copies the text to the log, each line after the prefix. The
+  // caller holds log_mutex().
+  void write_log(const char* s, std::streamsize n, const char* prefix) {
 
-    if (last == '\n')
-        logBuf->sputn(prefix, 3);
+    static char last = '\n'; // Single log file
 
-    return last = logBuf->sputc((char)c);
+    for (const char* end = s + n; s < end; )
+    {
+        const char* eol = std::find(s, end, '\n');
+        eol += eol < end;
+
+        if (last == '\n')
+            logBuf->sputn(prefix, 3);
+
+        logBuf->sputn(s, eol - s);
+        last = eol[-1];
+        s = eol;
+    }
   }
 };
 
 class Logger {
 
-  Logger() : in(cin.rdbuf(), file.rdbuf()), out(cout.rdbuf(), file.rdbuf()) {}
+  Logger() : in(cin.rdbuf(), file.rdbuf()), out(cout.rdbuf(), file.rdbuf()) {
+    output_queue(); // Destroyed after us, as it writes to cout
+  }
  ~Logger() { start(""); }
 
   ofstream file;
@@ -94,6 +263,9 @@ public:
 
     static Logger l;
 
+    output_queue().flush(&cout); // The lines before go to the previous stream
+    std::lock_guard<Mutex> lk(output_queue().writeMutex);
+
     if (!fname.empty() && !l.file.is_open())
     {
         l.file.open(fname, ifstream::out);
@@ -111,6 +283,8 @@ public:
 
 } // namespace
 
+TimePoint StartupTime;
+
 /// engine_info() returns the full name of the current Stockfish version. This
 /// will be either "Stockfish <Tag> DD-MM-YY" (where DD-MM-YY is the date when
 /// the program was compiled) or "Stockfish <Version>", depending on whether
@@ -158,23 +332,29 @@ void dbg_print() {
 }
 
 
-/// Used to serialize access to std::cout to avoid multiple threads writing at
-/// the same time.
+/// Used to serialize the output of the threads. IO_LOCK returns the line buffer
+/// of the calling thread, IO_UNLOCK queues its content for the output thread.
 
 std::ostream& operator<<(std::ostream& os, SyncCout sc) {
 
-  static Mutex m;
-
   if (sc == IO_LOCK)
-      m.lock();
-
-  if (sc == IO_UNLOCK)
-      m.unlock();
+  {
+      LineStream = &os;
+      return LineBuf;
+  }
 
+  output_queue().push(LineStream, LineBuf.str());
+  LineBuf.str("");
   return os;
 }
 
 
+/// flush_output() waits until the lines written with sync_cout to the given
+/// stream are in it.
+
+void flush_output(const std::ostream& os) { output_queue().flush(&os); }
+
+
 /// Trampoline helper to avoid moving Logger to misc.h
 void start_logger(const std::string& fname) { Logger::start(fname); }
 
@@ -211,35 +391,239 @@ void prefetch2(void* addr) {
   prefetch((uint8_t*)addr + 64);
 }
 
-namespace WinProcGroup {
 
-#ifndef _WIN32
+/// aligned_large_pages_alloc() allocates a zero-filled block of memory for the
+/// big tables, aligned at least to the cache line size, trying to have it backed
+/// by huge pages to reduce the TLB misses of the random accesses into the table.
+/// The method actually used is returned in 'method' so that the caller can
+/// report it. The matching aligned_large_pages_free() must be called with the
+/// same size. Returns nullptr if there is no memory at all.
+
+#if defined(_WIN32)
+
+static void* windows_large_pages_alloc(size_t size) {
+
+  const size_t largePageSize = GetLargePageMinimum();
+  HANDLE token;
+  LUID luid;
+  void* mem = nullptr;
+
+  if (!largePageSize)
+      return nullptr;
+
+  // Large pages need the SeLockMemoryPrivilege, that must be granted to the
+  // user and enabled for the process before calling VirtualAlloc().
+  if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+      return nullptr;
+
+  if (LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &luid))
+  {
+      TOKEN_PRIVILEGES tp, prevTp;
+      DWORD prevTpLen = 0;
+
+      tp.PrivilegeCount = 1;
+      tp.Privileges[0].Luid = luid;
+      tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+      // AdjustTokenPrivileges() succeeds also when the privilege is not held,
+      // so we have to check GetLastError() too.
+      if (   AdjustTokenPrivileges(token, FALSE, &tp, sizeof(tp), &prevTp, &prevTpLen)
+          && GetLastError() == ERROR_SUCCESS)
+      {
+          size_t lpSize = (size + largePageSize - 1) & ~(largePageSize - 1);
+          mem = VirtualAlloc(nullptr, lpSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+
+          // Restore the previous privilege state
+          AdjustTokenPrivileges(token, FALSE, &prevTp, 0, nullptr, nullptr);
+      }
+  }
+
+  CloseHandle(token);
+  return mem;
+}
+
+void* aligned_large_pages_alloc(size_t size, std::string& method) {
+
+  void* mem = windows_large_pages_alloc(size);
+
+  if (mem)
+      method = "large pages";
+  else
+  {
+      mem = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+      method = "default pages";
+  }
+  return mem;
+}
 
-void bindThisThread(size_t) {}
+void aligned_large_pages_free(void* mem, size_t) {
+
+  if (mem)
+      VirtualFree(mem, 0, MEM_RELEASE);
+}
+
+#elif defined(__linux__)
+
+// The default huge page size, the "Hugepagesize" of /proc/meminfo, or 2 MB if
+// not found. Both MAP_HUGETLB and the transparent huge pages use it on x86-64.
+static size_t huge_page_size() {
+
+  static const size_t size = [] {
+      std::ifstream meminfo("/proc/meminfo");
+      std::string token;
+      size_t kb;
+
+      while (meminfo >> token)
+          if (token == "Hugepagesize:" && meminfo >> kb && kb && !(kb & (kb - 1)))
+              return kb * 1024;
+
+      return size_t(2 * 1024 * 1024);
+  }();
+
+  return size;
+}
+
+static size_t huge_page_round(size_t size) {
+  return (size + huge_page_size() - 1) & ~(huge_page_size() - 1);
+}
+
+void* aligned_large_pages_alloc(size_t size, std::string& method) {
+
+  size = huge_page_round(size);
+
+  // First try the explicitly reserved huge pages (see /proc/sys/vm/nr_hugepages),
+  // the fastest option but usually not available unless set up by the admin.
+  void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (mem != MAP_FAILED)
+  {
+      method = "huge pages";
+      return mem;
+  }
+
+  // Otherwise map a huge page aligned block, unmapping the slack on both sides,
+  // and ask the kernel to back it with transparent huge pages.
+  char* raw = (char*)mmap(nullptr, size + huge_page_size(), PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED)
+      return nullptr;
+
+  char* aligned = (char*)huge_page_round(uintptr_t(raw));
+
+  if (aligned > raw)
+      munmap(raw, aligned - raw);
+
+  munmap(aligned + size, raw + huge_page_size() - aligned);
+
+  method = madvise(aligned, size, MADV_HUGEPAGE) ? "default pages"
+                                                 : "transparent huge pages";
+  return aligned;
+}
+
+void aligned_large_pages_free(void* mem, size_t size) {
+
+  if (mem)
+      munmap(mem, huge_page_round(size));
+}
 
 #else
 
-/// get_group() retrieves logical processor information using Windows specific
-/// API and returns the best group id for the thread with index idx. Original
-/// code from Texel by Peter Österlund.
+void* aligned_large_pages_alloc(size_t size, std::string& method) {
+
+  void* mem;
 
-int get_group(size_t idx) {
+  if (posix_memalign(&mem, 4096, size))
+      return nullptr;
 
-  int threads = 0;
-  int nodes = 0;
-  int cores = 0;
+  std::memset(mem, 0, size);
+  method = "default pages";
+  return mem;
+}
+
+void aligned_large_pages_free(void* mem, size_t) {
+  free(mem);
+}
+
+#endif
+
+
+namespace NumaBinding {
+
+namespace {
+
+/// Topology keeps what we know about the machine: for each NUMA node the
+/// number of physical cores and of logical processors, and on Linux the
+/// list of the node's logical processors.
+
+struct Topology {
+  std::vector<int> cores, threads;
+  std::vector<std::vector<int>> cpus;
+};
+
+
+/// binding_enabled() tells whether threads should be bound, according to the
+/// "NUMA Binding" UCI option. In "auto" mode we bind only if running at least 8
+/// threads on a machine with more than one node. Otherwise all this machinery
+/// is not needed, and we could be one of many one-threaded processes sharing
+/// the machine, for instance in fishtest, so better let the OS decide.
+
+bool binding_enabled(const Topology& topo) {
+
+  const std::string mode = Options["NUMA Binding"];
+
+  return    mode == "on"
+         || (mode == "auto" && topo.cores.size() > 1 && int(Options["Threads"]) >= 8);
+}
+
+
+/// best_node() returns the node for the thread with index idx. We run as many
+/// threads as possible on the same node until its core limit is reached, then
+/// move on filling the next node. Threads exceeding the number of cores are
+/// spread evenly across the nodes that have still free logical processors.
+/// If we have more threads than logical processors then return -1 and let the
+/// OS decide what to do.
+
+int best_node(const Topology& topo, size_t idx) {
+
+  std::vector<int> nodes;
+  std::vector<int> spare(topo.threads);
+
+  for (size_t n = 0; n < topo.cores.size(); ++n)
+      for (int i = 0; i < topo.cores[n]; ++i)
+          nodes.push_back(int(n)), --spare[n];
+
+  for (bool found = true; found; )
+  {
+      found = false;
+      for (size_t n = 0; n < spare.size(); ++n)
+          if (spare[n] > 0)
+              nodes.push_back(int(n)), --spare[n], found = true;
+  }
+
+  return idx < nodes.size() ? nodes[idx] : -1;
+}
+
+#if defined(_WIN32)
+
+/// read_topology() retrieves logical processor information using Windows specific
+/// API. Original code from Texel by Peter Österlund.
+
+Topology read_topology() {
+
+  Topology topo;
   DWORD returnLength = 0;
   DWORD byteOffset = 0;
+  int nodes = 0, cores = 0, threads = 0;
 
   // Early exit if the needed API is not available at runtime
   HMODULE k32 = GetModuleHandle("Kernel32.dll");
   auto fun1 = (fun1_t)GetProcAddress(k32, "GetLogicalProcessorInformationEx");
   if (!fun1)
-      return -1;
+      return topo;
 
   // First call to get returnLength. We expect it to fail due to null buffer
   if (fun1(RelationAll, nullptr, &returnLength))
-      return -1;
+      return topo;
 
   // Once we know returnLength, allocate the buffer
   SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *buffer, *ptr;
@@ -249,7 +633,7 @@ int get_group(size_t idx) {
   if (!fun1(RelationAll, buffer, &returnLength))
   {
       free(buffer);
-      return -1;
+      return topo;
   }
 
   while (ptr->Size > 0 && byteOffset + ptr->Size <= returnLength)
@@ -269,43 +653,21 @@ int get_group(size_t idx) {
 
   free(buffer);
 
-  std::vector<int> groups;
-
-  // Run as many threads as possible on the same node until core limit is
-  // reached, then move on filling the next node.
+  // The API does not tell which core belongs to which node, so assume that the
+  // nodes are all equal, as they are in practice.
   for (int n = 0; n < nodes; n++)
-      for (int i = 0; i < cores / nodes; i++)
-          groups.push_back(n);
-
-  // In case a core has more than one logical processor (we assume 2) and we
-  // have still threads to allocate, then spread them evenly across available
-  // nodes.
-  for (int t = 0; t < threads - cores; t++)
-      groups.push_back(t % nodes);
-
-  // If we still have more threads than the total number of logical processors
-  // then return -1 and let the OS to decide what to do.
-  return idx < groups.size() ? groups[idx] : -1;
-}
-
-
-/// bindThisThread() set the group affinity of the current thread
+  {
+      topo.cores.push_back(cores / nodes);
+      topo.threads.push_back(threads / nodes);
+  }
 
-void bindThisThread(size_t idx) {
+  return topo;
+}
 
-  // If OS already scheduled us on a different group than 0 then don't overwrite
-  // the choice, eventually we are one of many one-threaded processes running on
-  // some Windows NUMA hardware, for instance in fishtest. To make it simple,
-  // just check if running threads are below a threshold, in this case all this
-  // NUMA machinery is not needed.
-  if (Threads.size() < 8)
-      return;
 
-  // Use only local variables to be thread-safe
-  int group = get_group(idx);
+/// bind_to_node() sets the group affinity of the current thread
 
-  if (group == -1)
-      return;
+void bind_to_node(const Topology&, int node) {
 
   // Early exit if the needed API are not available at runtime
   HMODULE k32 = GetModuleHandle("Kernel32.dll");
@@ -316,10 +678,158 @@ void bindThisThread(size_t idx) {
       return;
 
   GROUP_AFFINITY affinity;
-  if (fun2(group, &affinity))
+  if (fun2(USHORT(node), &affinity))
       fun3(GetCurrentThread(), &affinity, nullptr);
 }
 
+#elif defined(__linux__)
+
+/// read_cpus() parses a sysfs cpu list like "0-7,16-23" into the list of
+/// logical processors. The list of a node with only memory is empty.
+
+std::vector<int> read_cpus(const std::string& fname) {
+
+  std::vector<int> cpus;
+  std::ifstream f(fname);
+  std::string token;
+
+  while (std::getline(f, token, ','))
+  {
+      std::istringstream is(token);
+      int first, last;
+      char dash;
+
+      if (!(is >> first)) // Empty or blank
+          continue;
+
+      if (!(is >> dash >> last) || dash != '-')
+          last = first;
+
+      for (int cpu = first; cpu <= last; ++cpu)
+          cpus.push_back(cpu);
+  }
+
+  return cpus;
+}
+
+
+/// read_topology() reads the NUMA nodes from sysfs, the nodeN directories that
+/// exist, as the numbers can have gaps. Nodes without logical processors, like
+/// memory-only nodes, are skipped. A physical core is identified by its package
+/// and core ids, shared by all its SMT siblings.
+
+Topology read_topology() {
+
+  const std::string root = "/sys/devices/system/";
+  Topology topo;
+  std::vector<int> nodes;
+
+  if (DIR* dir = opendir((root + "node").c_str()))
+  {
+      while (dirent* entry = readdir(dir))
+          if (!std::strncmp(entry->d_name, "node", 4) && std::isdigit(entry->d_name[4]))
+              nodes.push_back(std::atoi(entry->d_name + 4));
+
+      closedir(dir);
+  }
+
+  std::sort(nodes.begin(), nodes.end());
+
+  for (int n : nodes)
+  {
+      std::vector<int> cpus = read_cpus(root + "node/node" + std::to_string(n) + "/cpulist");
+      std::vector<std::pair<int, int>> cores;
+
+      if (cpus.empty())
+          continue;
+
+      for (int cpu : cpus)
+      {
+          const std::string dir = root + "cpu/cpu" + std::to_string(cpu) + "/topology/";
+          std::ifstream package(dir + "physical_package_id"), core(dir + "core_id");
+          std::pair<int, int> id(-1, cpu);
+
+          package >> id.first;
+          core >> id.second;
+
+          if (std::find(cores.begin(), cores.end(), id) == cores.end())
+              cores.push_back(id);
+      }
+
+      topo.cores.push_back(int(cores.size()));
+      topo.threads.push_back(int(cpus.size()));
+      topo.cpus.push_back(cpus);
+  }
+
+  return topo;
+}
+
+
+/// bind_to_node() sets the affinity of the current thread to all the logical
+/// processors of the node, the scheduler is free to move it inside the node.
+
+void bind_to_node(const Topology& topo, int node) {
+
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+
+  for (int cpu : topo.cpus[node])
+      CPU_SET(cpu, &mask);
+
+  sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+#else
+
+Topology read_topology() { return Topology(); }
+
+void bind_to_node(const Topology&, int) {}
+
 #endif
 
-} // namespace WinProcGroup
+const Topology& topology_info() {
+
+  static const Topology topo = read_topology(); // Thread-safe initialization
+  return topo;
+}
+
+} // namespace
+
+
+/// bindThisThread() binds the current thread, with index idx, to its NUMA node.
+/// It should be called before the thread touches its data, so that on systems
+/// with a first-touch policy the memory is allocated on the same node.
+
+void bindThisThread(size_t idx) {
+
+  const Topology& topo = topology_info();
+
+  if (!binding_enabled(topo))
+      return;
+
+  int node = best_node(topo, idx);
+
+  if (node != -1)
+      bind_to_node(topo, node);
+}
+
+
+/// topology() returns a description of the detected NUMA topology
+
+std::string topology() {
+
+  const Topology& topo = topology_info();
+  std::stringstream ss;
+  int cores = 0, threads = 0;
+
+  for (size_t n = 0; n < topo.cores.size(); ++n)
+      cores += topo.cores[n], threads += topo.threads[n];
+
+  ss << topo.cores.size() << " NUMA nodes, " << cores << " cores, "
+     << threads << " logical processors, binding "
+     << (binding_enabled(topo) ? "enabled" : "disabled");
+
+  return ss.str();
+}
+
+} // namespace NumaBinding
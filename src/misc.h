@@ -21,8 +21,10 @@
 #ifndef MISC_H_INCLUDED
 #define MISC_H_INCLUDED
 
+#include <atomic>
 #include <cassert>
 #include <chrono>
+#include <cstring>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -33,6 +35,8 @@ const std::string engine_info(bool to_uci = false);
 void prefetch(void* addr);
 void prefetch2(void* addr);
 void start_logger(const std::string& fname);
+void* aligned_large_pages_alloc(size_t size, std::string& method);
+void aligned_large_pages_free(void* mem, size_t size);
 
 void dbg_hit_on(bool b);
 void dbg_hit_on(bool c, bool b);
@@ -46,22 +50,137 @@ inline TimePoint now() {
         (std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
-template<class Entry, int Size>
+inline int64_t now_us() { // As now(), in microseconds, to time short intervals
+  return std::chrono::duration_cast<std::chrono::microseconds>
+        (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+extern TimePoint StartupTime; // Spent in main() before entering UCI::loop()
+
+/// HashTable is used for the per-thread pawn and material tables. Its size is
+/// set at runtime by resize(), in bytes rounded down to a power of 2 number of
+/// entries. It is called by the owning thread itself, so that memory is local
+/// to the thread's NUMA node. Hits and misses are counted by the probe code.
+
+template<class Entry>
 struct HashTable {
-  Entry* operator[](Key key) { return &table[(uint32_t)key & (Size - 1)]; }
+
+  void resize(size_t size) {
+    size_t count = 1;
+    while (2 * count * sizeof(Entry) <= size)
+        count *= 2;
+
+    table = std::vector<Entry>(count);
+    mask = count - 1;
+    hits = misses = 0;
+  }
+
+  Entry* operator[](Key key) { return &table[key & mask]; }
+
+  uint64_t hits = 0, misses = 0;
 
 private:
-  std::vector<Entry> table = std::vector<Entry>(Size);
+  std::vector<Entry> table;
+  size_t mask = 0;
+};
+
+
+/// SharedHashTable is an optional second level cache for the pawn and material
+/// tables, shared by all the threads, so that a structure evaluated by one thread
+/// is available to the others. It is lock-free: entries are copied in and out of
+/// the slots under a sequence lock, whose counter is odd while a writer updates
+/// the slot. A reader treats as a miss a slot whose counter was odd or changed
+/// during the copy, and a writer skips a slot that someone else is updating.
+/// Entry must be trivially copyable and have a 'key' member.
+
+template<class Entry>
+class SharedHashTable {
+
+  struct Slot {
+    std::atomic<uint32_t> seq;
+    Entry entry;
+  };
+
+public:
+  bool enabled() const { return !table.empty(); }
+
+  // resize() sets the size in bytes, rounded down to a power of 2 number of
+  // slots. Zero disables the table. Must not be called during a search.
+  void resize(size_t size) {
+    size_t count = size >= sizeof(Slot);
+    while (count && 2 * count * sizeof(Slot) <= size)
+        count *= 2;
+
+    table = std::vector<Slot>(count);
+    mask = count - 1;
+  }
+
+  void clear() { resize(table.size() * sizeof(Slot)); }
+
+  bool probe(Key key, Entry* e) const {
+    const Slot& s = table[key & mask];
+    uint32_t seq = s.seq.load(std::memory_order_acquire);
+
+    if (seq & 1)
+        return false;
+
+    std::memcpy(e, &s.entry, sizeof(Entry));
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return s.seq.load(std::memory_order_relaxed) == seq && e->key == key;
+  }
+
+  void store(const Entry& e) {
+    Slot& s = table[e.key & mask];
+    uint32_t seq = s.seq.load(std::memory_order_relaxed);
+
+    if ((seq & 1) || !s.seq.compare_exchange_strong(seq, seq + 1, std::memory_order_acquire))
+        return;
+
+    std::memcpy(&s.entry, &e, sizeof(Entry));
+    s.seq.store(seq + 2, std::memory_order_release);
+  }
+
+private:
+  std::vector<Slot> table;
+  size_t mask = 0;
 };
 
 
 enum SyncCout { IO_LOCK, IO_UNLOCK };
 std::ostream& operator<<(std::ostream&, SyncCout);
+std::ostream& output(); // Stream of the current engine, see Engine
+void flush_output(const std::ostream& os);
 
-#define sync_cout std::cout << IO_LOCK
+#define sync_cout output() << IO_LOCK
 #define sync_endl std::endl << IO_UNLOCK
 
 
+/// ValueList is a vector with a fixed capacity, stored in place, for small lists
+/// that are copied or grown often and must not allocate, like the PV of a root
+/// move. The caller makes sure that the size never exceeds MaxSize.
+
+template<typename T, std::size_t MaxSize>
+class ValueList {
+
+public:
+  ValueList() = default;
+  ValueList(std::size_t n, const T& value) { while (size_ < n) push_back(value); }
+
+  std::size_t size() const { return size_; }
+  void resize(std::size_t newSize) { assert(newSize <= MaxSize); size_ = newSize; }
+  void push_back(const T& value) { assert(size_ < MaxSize); values_[size_++] = value; }
+  T& operator[](std::size_t index) { return values_[index]; }
+  const T& operator[](std::size_t index) const { return values_[index]; }
+  const T* begin() const { return values_; }
+  const T* end() const { return values_ + size_; }
+
+private:
+  T values_[MaxSize];
+  std::size_t size_ = 0;
+};
+
+
 /// xorshift64star Pseudo-Random Number Generator
 /// This class is based on original code written and dedicated
 /// to the public domain by Sebastiano Vigna (2014).
@@ -99,14 +218,16 @@ public:
 };
 
 
-/// Under Windows it is not possible for a process to run on more than one
-/// logical processor group. This usually means to be limited to use max 64
-/// cores. To overcome this, some special platform specific API should be
-/// called to set group affinity for each thread. Original code from Texel by
-/// Peter Österlund.
+/// On NUMA machines we want each search thread to stay on one node, close to
+/// the memory it uses. Moreover under Windows it is not possible for a process
+/// to run on more than one logical processor group, usually meaning a limit of
+/// 64 cores. To overcome this, threads are bound to a node with the platform
+/// specific API (group affinity on Windows, CPU affinity on Linux), according
+/// to the "NUMA Binding" UCI option. Original code from Texel by Peter Österlund.
 
-namespace WinProcGroup {
+namespace NumaBinding {
   void bindThisThread(size_t idx);
+  std::string topology();
 }
 
 #endif // #ifndef MISC_H_INCLUDED
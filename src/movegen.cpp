@@ -22,6 +22,7 @@
 
 #include "movegen.h"
 #include "position.h"
+#include "profile.h"
 
 namespace {
 
@@ -144,6 +145,7 @@ namespace {
     assert(Pt != KING && Pt != PAWN);
 
     const Square* pl = pos.squares<Pt>(us);
+    Bitboard pinned = pos.pinned_pieces(us);
 
     for (Square from = *pl; from != SQ_NONE; from = *++pl)
     {
@@ -162,6 +164,10 @@ namespace {
         if (Checks)
             b &= pos.check_squares(Pt);
 
+        // A pinned piece can move only along the line of its king
+        if (pinned & from)
+            b &= LineBB[pos.square<KING>(us)][from];
+
         while (b)
             *moveList++ = make_move(from, pop_lsb(&b));
     }
@@ -174,8 +180,24 @@ namespace {
   ExtMove* generate_all(const Position& pos, ExtMove* moveList, Bitboard target) {
 
     const bool Checks = Type == QUIET_CHECKS;
+    const Color Them = (Us == WHITE ? BLACK : WHITE);
+
+    Square ksq = pos.square<KING>(Us);
+    Bitboard pinnedPawns = pos.pinned_pieces(Us) & pos.pieces(PAWN);
+    ExtMove* cur = moveList;
 
     moveList = generate_pawn_moves<Us, Type>(pos, moveList, target);
+
+    // Pinned pawns are rare, so their moves are filtered afterwards
+    if (pinnedPawns)
+    {
+        while (cur != moveList)
+            if ((pinnedPawns & from_sq(*cur)) && !aligned(from_sq(*cur), to_sq(*cur), ksq))
+                *cur = (--moveList)->move;
+            else
+                ++cur;
+    }
+
     moveList = generate_moves< QUEEN, Checks>(pos, moveList, Us, target);
     moveList = generate_moves<BISHOP, Checks>(pos, moveList, Us, target);
     moveList = generate_moves<KNIGHT, Checks>(pos, moveList, Us, target);
@@ -183,30 +205,93 @@ namespace {
 
     if (Type != QUIET_CHECKS && Type != EVASIONS)
     {
-        Square ksq = pos.square<KING>(Us);
         Bitboard b = pos.attacks_from<KING>(ksq) & target;
         while (b)
-            *moveList++ = make_move(ksq, pop_lsb(&b));
+        {
+            Square to = pop_lsb(&b);
+            if (!(pos.attackers_to(to) & pos.pieces(Them)))
+                *moveList++ = make_move(ksq, to);
+        }
     }
 
     return moveList;
   }
 
+
+  // count_moves() returns the number of legal moves when not in check, using
+  // only bitboards: pinned pieces can move only along the line of the king,
+  // that in Makruk can be pinned only by rooks.
+  template<Color Us>
+  size_t count_moves(const Position& pos) {
+
+    const Color  Them  = (Us == WHITE ? BLACK      : WHITE);
+    const Square Up    = (Us == WHITE ? NORTH      : SOUTH);
+    const Square Right = (Us == WHITE ? NORTH_EAST : SOUTH_WEST);
+    const Square Left  = (Us == WHITE ? NORTH_WEST : SOUTH_EAST);
+
+    assert(!pos.checkers());
+
+    Square ksq = pos.square<KING>(Us);
+    Bitboard pinned = pos.pinned_pieces(Us);
+    Bitboard target = ~pos.pieces(Us);
+    Bitboard pawns = pos.pieces(Us, PAWN) & ~pinned;
+    Bitboard b;
+
+    // Each pawn move, including a promotion, counts as a single move
+    size_t cnt =  popcount(shift<Up   >(pawns) & ~pos.pieces())
+                + popcount(shift<Right>(pawns) & pos.pieces(Them))
+                + popcount(shift<Left >(pawns) & pos.pieces(Them));
+
+    b = pinned & ~pos.pieces(KING);
+    while (b)
+    {
+        Square from = pop_lsb(&b);
+        PieceType pt = type_of(pos.piece_on(from));
+        Bitboard moves =  pt == PAWN   ? (pos.attacks_from<PAWN>(from, Us) & pos.pieces(Them))
+                                       | (SquareBB[from + Up] & ~pos.pieces())
+                        : pt == BISHOP ? pos.attacks_from<BISHOP>(from, Us) & target
+                                       : pos.attacks_from(pt, from) & target;
+
+        cnt += popcount(moves & LineBB[ksq][from]);
+    }
+
+    b = pos.pieces(Us) & ~pinned & ~pos.pieces(PAWN, KING);
+    while (b)
+    {
+        Square from = pop_lsb(&b);
+        PieceType pt = type_of(pos.piece_on(from));
+
+        cnt += popcount((pt == BISHOP ? pos.attacks_from<BISHOP>(from, Us)
+                                      : pos.attacks_from(pt, from)) & target);
+    }
+
+    b = pos.attacks_from<KING>(ksq) & target;
+    while (b)
+        cnt += !(pos.attackers_to(pop_lsb(&b)) & pos.pieces(Them));
+
+    return cnt;
+  }
+
 } // namespace
 
 
-/// generate<CAPTURES> generates all pseudo-legal captures and queen
-/// promotions. Returns a pointer to the end of the move list.
+/// generate<CAPTURES> generates all legal captures and queen promotions.
+/// Returns a pointer to the end of the move list.
 ///
-/// generate<QUIETS> generates all pseudo-legal non-captures and
-/// underpromotions. Returns a pointer to the end of the move list.
+/// generate<QUIETS> generates all legal non-captures and underpromotions.
+/// Returns a pointer to the end of the move list.
 ///
-/// generate<NON_EVASIONS> generates all pseudo-legal captures and
-/// non-captures. Returns a pointer to the end of the move list.
+/// generate<NON_EVASIONS> generates all legal captures and non-captures.
+/// Returns a pointer to the end of the move list.
+///
+/// All the generators emit only legal moves: pinned pieces are restricted to
+/// the line of their king and king moves to squares not attacked by the enemy.
 
 template<GenType Type>
 ExtMove* generate(const Position& pos, ExtMove* moveList) {
 
+  PROFILE_SCOPE(GENERATE);
+
   assert(Type == CAPTURES || Type == QUIETS || Type == NON_EVASIONS);
   assert(!pos.checkers());
 
@@ -226,14 +311,17 @@ template ExtMove* generate<QUIETS>(const Position&, ExtMove*);
 template ExtMove* generate<NON_EVASIONS>(const Position&, ExtMove*);
 
 
-/// generate<QUIET_CHECKS> generates all pseudo-legal non-captures and knight
+/// generate<QUIET_CHECKS> generates all legal non-captures and knight
 /// underpromotions that give check. Returns a pointer to the end of the move list.
 template<>
 ExtMove* generate<QUIET_CHECKS>(const Position& pos, ExtMove* moveList) {
 
+  PROFILE_SCOPE(GENERATE);
+
   assert(!pos.checkers());
 
   Color us = pos.side_to_move();
+  Square ksq = pos.square<KING>(us);
   Bitboard dc = pos.discovered_check_candidates();
 
   while (dc)
@@ -247,8 +335,21 @@ ExtMove* generate<QUIET_CHECKS>(const Position& pos, ExtMove* moveList) {
      Bitboard b = (pt == BISHOP ? pos.attacks_from<BISHOP>(from, us) : pos.attacks_from(pt, from)) & ~pos.pieces();
 
      if (pt == KING)
+     {
          b &= ~PseudoAttacks[ROOK][pos.square<KING>(~us)];
 
+         while (b)
+         {
+             Square to = pop_lsb(&b);
+             if (!(pos.attackers_to(to) & pos.pieces(~us)))
+                 *moveList++ = make_move(from, to);
+         }
+         continue;
+     }
+
+     if (pos.pinned_pieces(us) & from)
+         b &= LineBB[ksq][from];
+
      while (b)
          *moveList++ = make_move(from, pop_lsb(&b));
   }
@@ -258,32 +359,29 @@ ExtMove* generate<QUIET_CHECKS>(const Position& pos, ExtMove* moveList) {
 }
 
 
-/// generate<EVASIONS> generates all pseudo-legal check evasions when the side
+/// generate<EVASIONS> generates all legal check evasions when the side
 /// to move is in check. Returns a pointer to the end of the move list.
 template<>
 ExtMove* generate<EVASIONS>(const Position& pos, ExtMove* moveList) {
 
+  PROFILE_SCOPE(GENERATE);
+
   assert(pos.checkers());
 
   Color us = pos.side_to_move();
   Square ksq = pos.square<KING>(us);
-  Bitboard sliderAttacks = 0;
-  Bitboard sliders = pos.checkers() & pos.pieces(ROOK);
 
-  // Find all the squares attacked by slider checkers. We will remove them from
-  // the king evasions in order to skip known illegal moves, which avoids any
-  // useless legality checks later on.
-  while (sliders)
+  // Generate evasions for king, capture and non capture moves. The king is
+  // removed from the occupancy, so that squares behind it on the line of a
+  // checking rook are seen as attacked.
+  Bitboard b = pos.attacks_from<KING>(ksq) & ~pos.pieces(us);
+  while (b)
   {
-      Square checksq = pop_lsb(&sliders);
-      sliderAttacks |= LineBB[checksq][ksq] ^ checksq;
+      Square to = pop_lsb(&b);
+      if (!(pos.attackers_to(to, pos.pieces() ^ ksq) & pos.pieces(~us)))
+          *moveList++ = make_move(ksq, to);
   }
 
-  // Generate evasions for king, capture and non capture moves
-  Bitboard b = pos.attacks_from<KING>(ksq) & ~pos.pieces(us) & ~sliderAttacks;
-  while (b)
-      *moveList++ = make_move(ksq, pop_lsb(&b));
-
   if (more_than_one(pos.checkers()))
       return moveList; // Double check, only a king move can save the day
 
@@ -301,18 +399,17 @@ ExtMove* generate<EVASIONS>(const Position& pos, ExtMove* moveList) {
 template<>
 ExtMove* generate<LEGAL>(const Position& pos, ExtMove* moveList) {
 
-  Bitboard pinned = pos.pinned_pieces(pos.side_to_move());
-  Square ksq = pos.square<KING>(pos.side_to_move());
-  ExtMove* cur = moveList;
+  return pos.checkers() ? generate<EVASIONS    >(pos, moveList)
+                        : generate<NON_EVASIONS>(pos, moveList);
+}
+
+
+/// count_legal() returns the number of legal moves, as MoveList<LEGAL>.size()
+/// but without generating them when not in check. It is used by perft leaves.
 
-  moveList = pos.checkers() ? generate<EVASIONS    >(pos, moveList)
-                            : generate<NON_EVASIONS>(pos, moveList);
-  while (cur != moveList)
-      if (   (pinned || from_sq(*cur) == ksq)
-          && !pos.legal(*cur))
-          *cur = (--moveList)->move;
-      else
-          ++cur;
+size_t count_legal(const Position& pos) {
 
-  return moveList;
+  return pos.checkers()               ? MoveList<LEGAL>(pos).size()
+        : pos.side_to_move() == WHITE ? count_moves<WHITE>(pos)
+                                      : count_moves<BLACK>(pos);
 }
@@ -18,9 +18,11 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <cassert>
 
 #include "movepick.h"
+#include "profile.h"
 
 namespace {
 
@@ -75,7 +77,7 @@ MovePicker::MovePicker(const Position& p, Move ttm, Depth d, const ButterflyHist
   assert(d > DEPTH_ZERO);
 
   stage = pos.checkers() ? EVASION : MAIN_SEARCH;
-  ttMove = ttm && pos.pseudo_legal(ttm) ? ttm : MOVE_NONE;
+  ttMove = ttm && pos.pseudo_legal(ttm) && pos.legal(ttm) ? ttm : MOVE_NONE;
   stage += (ttMove == MOVE_NONE);
 }
 
@@ -101,7 +103,7 @@ MovePicker::MovePicker(const Position& p, Move ttm, Depth d, const ButterflyHist
       return;
   }
 
-  ttMove = ttm && pos.pseudo_legal(ttm) ? ttm : MOVE_NONE;
+  ttMove = ttm && pos.pseudo_legal(ttm) && pos.legal(ttm) ? ttm : MOVE_NONE;
   stage += (ttMove == MOVE_NONE);
 }
 
@@ -115,6 +117,7 @@ MovePicker::MovePicker(const Position& p, Move ttm, Value th)
   stage = PROBCUT;
   ttMove =   ttm
           && pos.pseudo_legal(ttm)
+          && pos.legal(ttm)
           && pos.capture(ttm)
           && pos.see_ge(ttm, threshold) ? ttm : MOVE_NONE;
 
@@ -129,17 +132,27 @@ void MovePicker::score() {
 
   static_assert(Type == CAPTURES || Type == QUIETS || Type == EVASIONS, "Wrong type");
 
+  // Quiets are the longest lists, look up the history tables of the side to
+  // move once for all of them.
+  if (Type == QUIETS)
+  {
+      const auto& history = (*mainHistory)[pos.side_to_move()];
+      const PieceToHistory &cmh = *contHistory[0], &fmh = *contHistory[1], &fm2 = *contHistory[3];
+
+      for (auto& m : *this)
+      {
+          Piece pc = pos.moved_piece(m);
+          Square to = to_sq(m);
+          m.value = history[from_to(m)] + cmh[pc][to] + fmh[pc][to] + fm2[pc][to];
+      }
+      return;
+  }
+
   for (auto& m : *this)
       if (Type == CAPTURES)
           m.value =  PieceValue[MG][pos.piece_on(to_sq(m))]
                    - Value(200 * relative_rank(pos.side_to_move(), to_sq(m)));
 
-      else if (Type == QUIETS)
-          m.value =  (*mainHistory)[pos.side_to_move()][from_to(m)]
-                   + (*contHistory[0])[pos.moved_piece(m)][to_sq(m)]
-                   + (*contHistory[1])[pos.moved_piece(m)][to_sq(m)]
-                   + (*contHistory[3])[pos.moved_piece(m)][to_sq(m)];
-
       else // Type == EVASIONS
       {
           if (pos.capture(m))
@@ -151,12 +164,13 @@ void MovePicker::score() {
 }
 
 /// next_move() is the most important method of the MovePicker class. It returns
-/// a new pseudo legal move every time it is called, until there are no more moves
+/// a new legal move every time it is called, until there are no more moves
 /// left. It picks the move with the biggest value from a list of generated moves
 /// taking care not to return the ttMove if it has already been searched.
 
 Move MovePicker::next_move(bool skipQuiets) {
 
+  PROFILE_SCOPE(NEXT_MOVE);
   Move move;
 
   switch (stage) {
@@ -167,10 +181,13 @@ Move MovePicker::next_move(bool skipQuiets) {
       return ttMove;
 
   case CAPTURES_INIT:
+  {
+      PROFILE_SCOPE(PICK_CAPTURES);
       endBadCaptures = cur = moves;
       endMoves = generate<CAPTURES>(pos, cur);
       score<CAPTURES>();
       ++stage;
+  }
       /* fallthrough */
 
   case GOOD_CAPTURES:
@@ -192,6 +209,7 @@ Move MovePicker::next_move(bool skipQuiets) {
       if (    move != MOVE_NONE
           &&  move != ttMove
           &&  pos.pseudo_legal(move)
+          &&  pos.legal(move)
           && !pos.capture(move))
           return move;
       /* fallthrough */
@@ -202,6 +220,7 @@ Move MovePicker::next_move(bool skipQuiets) {
       if (    move != MOVE_NONE
           &&  move != ttMove
           &&  pos.pseudo_legal(move)
+          &&  pos.legal(move)
           && !pos.capture(move))
           return move;
       /* fallthrough */
@@ -214,16 +233,27 @@ Move MovePicker::next_move(bool skipQuiets) {
           &&  move != killers[0]
           &&  move != killers[1]
           &&  pos.pseudo_legal(move)
+          &&  pos.legal(move)
           && !pos.capture(move))
           return move;
       /* fallthrough */
 
   case QUIET_INIT:
+  {
+      PROFILE_SCOPE(PICK_QUIETS);
       cur = endBadCaptures;
       endMoves = generate<QUIETS>(pos, cur);
       score<QUIETS>();
+
+      // Once skipped, only the quiets with a positive score are returned, the
+      // others are removed before sorting. The order of the list is kept, so
+      // the sort returns the same moves in the same order.
+      if (skipQuiets)
+          endMoves = std::remove_if(cur, endMoves, [](const ExtMove& m) { return m.value < VALUE_ZERO; });
+
       partial_insertion_sort(cur, endMoves, -4000 * depth / ONE_PLY);
       ++stage;
+  }
       /* fallthrough */
 
   case QUIET:
@@ -248,10 +278,13 @@ Move MovePicker::next_move(bool skipQuiets) {
       break;
 
   case EVASIONS_INIT:
+  {
+      PROFILE_SCOPE(PICK_EVASIONS);
       cur = moves;
       endMoves = generate<EVASIONS>(pos, cur);
       score<EVASIONS>();
       ++stage;
+  }
       /* fallthrough */
 
   case ALL_EVASIONS:
@@ -196,6 +196,8 @@ namespace {
 
 namespace Pawns {
 
+SharedTable Shared; // Optional table shared by all threads
+
 /// Pawns::init() initializes some tables needed by evaluation. Instead of using
 /// hard-coded tables, when makes sense, we prefer to calculate them with a formula
 /// to reduce independent parameters and to allow easier tuning and better insight.
@@ -219,21 +221,42 @@ void init() {
 
 /// Pawns::probe() looks up the current position's pawns configuration in
 /// the pawns hash table. It returns a pointer to the Entry if the position
-/// is found. Otherwise a new Entry is computed and stored there, so we don't
-/// have to recompute all when the same pawns configuration occurs again.
+/// is found. Otherwise the entry is copied from the shared table, if enabled,
+/// or a new Entry is computed and stored there, so we don't have to recompute
+/// all when the same pawns configuration occurs again.
 
 Entry* probe(const Position& pos) {
 
   Key key = pos.pawn_key();
-  Entry* e = pos.this_thread()->pawnsTable[key];
+  Thread* th = pos.this_thread();
+  Entry* e = th->pawnsTable[key];
+
+  STATS_INC(PAWN_PROBE);
 
   if (e->key == key)
-      return e;
+  {
+      STATS_INC(PAWN_HIT);
+      return ++th->pawnsTable.hits, e;
+  }
+
+  ++th->pawnsTable.misses;
+
+  if (Shared.enabled())
+  {
+      ++th->sharedProbes;
+
+      if (Shared.probe(key, e))
+          return ++th->sharedHits, e;
+  }
 
   e->key = key;
   e->score = evaluate<WHITE>(pos, e) - evaluate<BLACK>(pos, e);
   e->asymmetry = popcount(e->semiopenFiles[WHITE] ^ e->semiopenFiles[BLACK]);
   e->openFiles = popcount(e->semiopenFiles[WHITE] & e->semiopenFiles[BLACK]);
+
+  if (Shared.enabled())
+      Shared.store(*e);
+
   return e;
 }
 
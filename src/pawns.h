@@ -79,7 +79,10 @@ struct Entry {
   int openFiles;
 };
 
-typedef HashTable<Entry, 16384> Table;
+typedef HashTable<Entry> Table;
+typedef SharedHashTable<Entry> SharedTable;
+
+extern SharedTable Shared;
 
 void init();
 Entry* probe(const Position& pos);
@@ -26,9 +26,11 @@
 #include <sstream>
 
 #include "bitboard.h"
+#include "globals.h"
 #include "misc.h"
 #include "movegen.h"
 #include "position.h"
+#include "profile.h"
 #include "thread.h"
 #include "tt.h"
 #include "uci.h"
@@ -46,10 +48,24 @@ namespace Zobrist {
   Key side, noPawns;
 }
 
+bool EnableCounting = true;
+
 namespace {
 
 const string PieceToChar(" PMSNRK  pmsnrk");
 
+// Marcel van Kervinck's cuckoo algorithm for fast detection of "upcoming repetition"
+// situations. Description of the algorithm in the following paper:
+// https://marcelk.net/2013-04-06/paper/upcoming-rep-v2.pdf
+
+// First and second hash functions for indexing the cuckoo tables
+inline int H1(Key h) { return h & 0x1fff; }
+inline int H2(Key h) { return (h >> 16) & 0x1fff; }
+
+// Cuckoo tables with Zobrist hashes of valid reversible moves, and the moves themselves
+Key cuckoo[8192];
+Move cuckooMove[8192];
+
 const Piece Pieces[] = { W_PAWN, W_QUEEN, W_BISHOP, W_KNIGHT, W_ROOK, W_KING,
                          B_PAWN, B_QUEEN, B_BISHOP, B_KNIGHT, B_ROOK, B_KING };
 
@@ -132,6 +148,38 @@ void Position::init() {
 
   Zobrist::side = rng.rand<Key>();
   Zobrist::noPawns = rng.rand<Key>();
+
+  // Prepare the cuckoo tables. A Khon cannot move straight back, so only its
+  // diagonal moves are reversible.
+  std::memset(cuckoo, 0, sizeof(cuckoo));
+  std::memset(cuckooMove, 0, sizeof(cuckooMove));
+  int count = 0;
+  for (Piece pc : Pieces)
+      for (Square s1 = SQ_A1; s1 <= SQ_H8; ++s1)
+          for (Square s2 = Square(s1 + 1); s2 <= SQ_H8; ++s2)
+          {
+              PieceType pt = type_of(pc);
+              Color c = color_of(pc);
+
+              if (   pt == PAWN
+                  || (pt == BISHOP ? !(BishopAttacks[c][s1] & s2) || !(BishopAttacks[c][s2] & s1)
+                                   : !(PseudoAttacks[pt][s1] & s2)))
+                  continue;
+
+              Move move = make_move(s1, s2);
+              Key key = Zobrist::psq[pc][s1] ^ Zobrist::psq[pc][s2] ^ Zobrist::side;
+              int i = H1(key);
+              while (true)
+              {
+                  std::swap(cuckoo[i], key);
+                  std::swap(cuckooMove[i], move);
+                  if (move == MOVE_NONE) // Arrived at empty slot?
+                      break;
+                  i = (i == H1(key)) ? H2(key) : H1(key); // Push victim to alternative slot
+              }
+              count++;
+          }
+  assert(count == 2044);
 }
 
 
@@ -258,6 +306,13 @@ void Position::set_state(StateInfo* si) const {
 
   set_check_info(si);
 
+  si->countingPly = counting_ply();
+
+  std::memset(si->stepAttacks, 0, sizeof(si->stepAttacks));
+  for (Color c = WHITE; c <= BLACK; ++c)
+      for (PieceType pt = QUEEN; pt <= KNIGHT; ++pt)
+          set_step_attacks(si, c, pt);
+
   for (Bitboard b = pieces(); b; )
   {
       Square s = pop_lsb(&b);
@@ -286,6 +341,41 @@ void Position::set_state(StateInfo* si) const {
 }
 
 
+/// Position::set_step_attacks() computes the squares attacked by the Mets, Khons
+/// or knights of the given color. do_move() calls it only for the piece types
+/// that changed, the other ones are copied from the previous state.
+
+void Position::set_step_attacks(StateInfo* si, Color c, PieceType pt) const {
+
+  assert(pt == QUEEN || pt == BISHOP || pt == KNIGHT);
+
+  Bitboard b = 0;
+  for (const Square* pl = pieceList[make_piece(c, pt)]; *pl != SQ_NONE; ++pl)
+      b |= pt == BISHOP ? BishopAttacks[c][*pl] : PseudoAttacks[pt][*pl];
+
+  si->stepAttacks[c][pt] = b;
+}
+
+
+/// Position::counting_ply() returns the value of the rule50 counter above which
+/// the position is a draw: 64 moves with pawns, otherwise the counting limit
+/// when a side has a bare king and 64 moves when not. K vs K is always a draw.
+
+int Position::counting_ply() const {
+
+  if (count<PAWN>())
+      return 127;
+
+  if (count<ALL_PIECES>() == 2)
+      return -1;
+
+  if (!EnableCounting)
+      return INT_MAX;
+
+  return 2 * (count<ALL_PIECES>(WHITE) == 1 || count<ALL_PIECES>(BLACK) == 1 ? counting_limit() : 64);
+}
+
+
 /// Position::set() is an overload to initialize the position object with
 /// the given endgame code string like "KBPKN". It is mainly a helper to
 /// get the material key out of an endgame code.
@@ -522,6 +612,7 @@ bool Position::gives_check(Move m) const {
 
 void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 
+  PROFILE_SCOPE(DO_MOVE);
   assert(is_ok(m));
   assert(&newSt != st);
 
@@ -572,9 +663,14 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
       st->materialKey ^= Zobrist::psq[captured][pieceCount[captured]];
       prefetch(thisThread->materialTable[st->materialKey]);
 
-      // Update incremental scores
+      // Update incremental scores and attacks
       st->psq -= PSQT::psq[captured][capsq];
 
+      if (type_of(captured) != PAWN && type_of(captured) != ROOK)
+          set_step_attacks(st, them, type_of(captured));
+
+      st->countingPly = counting_ply();
+
       // Reset rule 50 counter unless we are in a pawnless endgame
       if (count<PAWN>() || (type_of(captured) == PAWN && count<ALL_PIECES>(color_of(captured)) > 1))
           st->rule50 = 0;
@@ -613,8 +709,10 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
           // Update incremental score
           st->psq += PSQT::psq[promotion][to] - PSQT::psq[pc][to];
 
-          // Update material
+          // Update material and attacks
           st->nonPawnMaterial[us] += PieceValue[MG][promotion];
+          set_step_attacks(st, us, QUEEN);
+          st->countingPly = counting_ply();
       }
 
       // Update pawn hash key and prefetch access to pawnsTable
@@ -629,9 +727,12 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
           st->rule50 = 0;
   }
 
-  // Update incremental scores
+  // Update incremental scores and attacks
   st->psq += PSQT::psq[pc][to] - PSQT::psq[pc][from];
 
+  if (type_of(pc) >= QUEEN && type_of(pc) <= KNIGHT)
+      set_step_attacks(st, us, type_of(pc));
+
   // Set capture piece
   st->capturedPiece = captured;
 
@@ -655,6 +756,7 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
 
 void Position::undo_move(Move m) {
 
+  PROFILE_SCOPE(UNDO_MOVE);
   assert(is_ok(m));
 
   sideToMove = ~sideToMove;
@@ -752,6 +854,7 @@ Key Position::key_after(Move m) const {
 
 bool Position::see_ge(Move m, Value threshold) const {
 
+  PROFILE_SCOPE(SEE_GE);
   assert(is_ok(m));
 
   // Only deal with normal moves, assume others pass a simple see
@@ -818,20 +921,9 @@ bool Position::see_ge(Move m, Value threshold) const {
 
 bool Position::is_draw(int ply) const {
 
-  if (!count<PAWN>())
-  {
-      // K vs. K
-      if (count<ALL_PIECES>() == 2)
-          return true;
-
-      // Counting rules
-      if (   st->rule50 > 2 * ((count<ALL_PIECES>(WHITE) == 1 || count<ALL_PIECES>(BLACK) == 1) ? counting_limit() : 64)
-          && (!checkers() || MoveList<LEGAL>(*this).size())
-          && Options["EnableCounting"])
-          return true;
-  }
-  // 64-move rule
-  else if (st->rule50 > 127 && (!checkers() || MoveList<LEGAL>(*this).size()))
+  // Counting rules, 64-move rule and K vs. K. When in check the search tells
+  // a mate from a draw once the evasions are known.
+  if (counting_draw() && !checkers())
       return true;
 
   int end = std::min(st->rule50, st->pliesFromNull);
@@ -857,6 +949,61 @@ bool Position::is_draw(int ply) const {
 }
 
 
+/// Position::has_game_cycle() tests if the position has a move which draws by
+/// repetition, or an earlier position has a move that directly reaches the
+/// current position.
+
+bool Position::has_game_cycle(int ply) const {
+
+  int j;
+
+  int end = std::min(st->rule50, st->pliesFromNull);
+
+  if (end < 3)
+    return false;
+
+  Key originalKey = st->key;
+  StateInfo* stp = st->previous;
+
+  for (int i = 3; i <= end; i += 2)
+  {
+      stp = stp->previous->previous;
+
+      Key moveKey = originalKey ^ stp->key;
+      if (   (j = H1(moveKey), cuckoo[j] == moveKey)
+          || (j = H2(moveKey), cuckoo[j] == moveKey))
+      {
+          Move move = cuckooMove[j];
+          Square s1 = from_sq(move);
+          Square s2 = to_sq(move);
+
+          if (!(between_bb(s1, s2) & pieces()))
+          {
+              if (ply > i)
+                  return true;
+
+              // For nodes before or at the root, check that the move is a
+              // repetition rather than a move to the current position.
+              // In the cuckoo table, both moves Rc1c5 and Rc5c1 are stored in
+              // the same location, so we have to select which square to check.
+              if (color_of(piece_on(empty(s1) ? s2 : s1)) != side_to_move())
+                  continue;
+
+              // For repetitions before or at the root, require one more
+              StateInfo* next_stp = stp;
+              for (int k = i + 2; k <= end; k += 2)
+              {
+                  next_stp = next_stp->previous->previous;
+                  if (next_stp->key == stp->key)
+                     return true;
+              }
+          }
+      }
+  }
+  return false;
+}
+
+
 /// Position::flip() flips position with the white and black sides reversed. This
 /// is only useful for debugging e.g. for finding evaluation symmetry bugs.
 
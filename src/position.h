@@ -22,9 +22,8 @@
 #define POSITION_H_INCLUDED
 
 #include <cassert>
-#include <deque>
-#include <memory> // For std::unique_ptr
 #include <string>
+#include <vector>
 
 #include "bitboard.h"
 #include "types.h"
@@ -43,6 +42,8 @@ struct StateInfo {
   int    rule50;
   int    pliesFromNull;
   Score  psq;
+  int    countingPly;
+  Bitboard stepAttacks[COLOR_NB][KNIGHT + 1];
 
   // Not copied when making a move (will be recomputed anyhow)
   Key        key;
@@ -54,11 +55,16 @@ struct StateInfo {
   Bitboard   checkSquares[PIECE_TYPE_NB];
 };
 
+/// EnableCounting is set by the UCI option of the same name. When it is false,
+/// pawnless positions are never drawn by the counting rules.
+extern bool EnableCounting;
+
 /// A list to keep track of the position states along the setup moves (from the
 /// start position to the position just before the search starts). Needed by
-/// 'draw by repetition' detection. Use a std::deque because pointers to
-/// elements are not invalidated upon list resizing.
-typedef std::unique_ptr<std::deque<StateInfo>> StateListPtr;
+/// 'draw by repetition' detection. Room for all the moves is reserved before
+/// they are made, so that pointers to elements are not invalidated, and the
+/// list is refilled by each new position, keeping its memory.
+typedef std::vector<StateInfo> StateList;
 
 
 /// Position class stores information regarding the board representation as
@@ -107,6 +113,7 @@ public:
   template<PieceType> Bitboard attacks_from(Square s) const;
   template<PieceType> Bitboard attacks_from(Square s, Color c) const;
   Bitboard slider_blockers(Bitboard sliders, Square s, Bitboard& pinners) const;
+  Bitboard attacks_by(Color c, PieceType pt) const;
 
   // Properties of moves
   bool legal(Move m) const;
@@ -144,8 +151,11 @@ public:
   bool is_chess960() const;
   Thread* this_thread() const;
   bool is_draw(int ply) const;
+  bool counting_draw() const;
+  bool has_game_cycle(int ply) const;
   int rule50_count() const;
   int counting_limit() const;
+  int counting_ply() const;
   Score psq_score() const;
   Value non_pawn_material(Color c) const;
   Value non_pawn_material() const;
@@ -158,6 +168,7 @@ private:
   // Initialization helpers (used while setting up a position)
   void set_state(StateInfo* si) const;
   void set_check_info(StateInfo* si) const;
+  void set_step_attacks(StateInfo* si, Color c, PieceType pt) const;
 
   // Other helpers
   void put_piece(Piece pc, Square s);
@@ -274,6 +285,14 @@ inline Bitboard Position::pinned_pieces(Color c) const {
   return st->blockersForKing[c] & pieces(c);
 }
 
+/// Position::attacks_by() returns the squares attacked by all the Mets, Khons
+/// or knights of the given color. They are updated incrementally in do_move().
+
+inline Bitboard Position::attacks_by(Color c, PieceType pt) const {
+  assert(pt == QUEEN || pt == BISHOP || pt == KNIGHT);
+  return st->stepAttacks[c][pt];
+}
+
 inline Bitboard Position::check_squares(PieceType pt) const {
   return st->checkSquares[pt];
 }
@@ -336,6 +355,15 @@ inline int Position::counting_limit() const {
   return 64;
 }
 
+/// Position::counting_draw() tests whether the rule50 counter has passed the
+/// counting limit, or the 64-move limit with pawns on the board. The limit is
+/// updated by do_move() whenever the material changes. A mated side still
+/// loses, this is checked by the search.
+
+inline bool Position::counting_draw() const {
+  return st->rule50 > st->countingPly;
+}
+
 inline bool Position::queen_pair(Color c) const {
   return   ( DarkSquares & pieces(c, QUEEN))
         && (~DarkSquares & pieces(c, QUEEN));
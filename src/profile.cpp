@@ -0,0 +1,81 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include "globals.h"
+#include "profile.h"
+#include "thread.h"
+
+namespace Profile {
+
+#ifdef USE_PROFILE
+thread_local Counters Local;
+#endif
+
+
+/// clear() resets the counters of a thread, called by Thread::clear()
+
+void clear(Counters* c) {
+
+  if (c)
+      std::memset(c, 0, sizeof(Counters));
+}
+
+
+/// report() sums the counters of all the threads and returns a table with
+/// calls, total ticks and ticks per call of each section, printed after bench.
+/// It is empty if the profiler is not compiled in. Threads must be idle.
+
+std::string report() {
+
+  std::stringstream ss;
+
+#ifdef USE_PROFILE
+  const char* names[] = { "evaluate", "generate", "next_move", "do_move",
+                          "undo_move", "see_ge", "tt_probe", "pick_captures",
+                          "pick_quiets", "pick_evasions" };
+  Counters sum;
+  clear(&sum);
+
+  for (Thread* th : Threads)
+      if (th->profile)
+          for (int i = 0; i < SECTION_NB; ++i)
+          {
+              sum.calls[i] += th->profile->calls[i];
+              sum.ticks[i] += th->profile->ticks[i];
+          }
+
+  ss << "\nSection               calls           ticks  ticks/call\n";
+
+  for (int i = 0; i < SECTION_NB; ++i)
+      ss << std::left << std::setw(13) << names[i] << std::right
+         << std::setw(14) << sum.calls[i]
+         << std::setw(16) << sum.ticks[i]
+         << std::setw(12) << sum.ticks[i] / std::max(sum.calls[i], uint64_t(1)) << "\n";
+#endif
+
+  return ss.str();
+}
+
+} // namespace Profile
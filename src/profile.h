@@ -0,0 +1,93 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROFILE_H_INCLUDED
+#define PROFILE_H_INCLUDED
+
+#include <cstdint>
+#include <string>
+
+#if defined(USE_PROFILE) && (defined(__x86_64__) || defined(__i386__))
+#  include <x86intrin.h>
+#elif defined(USE_PROFILE) && defined(_MSC_VER)
+#  include <intrin.h>
+#elif defined(USE_PROFILE)
+#  include <chrono>
+#endif
+
+/// Profile measures the time spent in the hot functions of search, with a
+/// scoped timer reading the CPU time stamp counter. It is compiled in only with
+/// USE_PROFILE (make profile=yes), otherwise PROFILE_SCOPE() is empty. Times
+/// are inclusive, so a nested section (for instance movegen called by the move
+/// picker) is counted in both. The pick_* sections time the stages of the move
+/// picker that generate and order a list of moves.
+
+namespace Profile {
+
+enum Section {
+  EVALUATE, GENERATE, NEXT_MOVE, DO_MOVE, UNDO_MOVE, SEE_GE, TT_PROBE,
+  PICK_CAPTURES, PICK_QUIETS, PICK_EVASIONS, SECTION_NB
+};
+
+struct Counters {
+  uint64_t calls[SECTION_NB];
+  uint64_t ticks[SECTION_NB];
+};
+
+void clear(Counters* c);
+std::string report();
+
+#ifdef USE_PROFILE
+
+extern thread_local Counters Local;
+
+inline uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_MSC_VER)
+  return __rdtsc();
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+struct Scope {
+  explicit Scope(Section s) : section(s), start(ticks()) {}
+ ~Scope() {
+    ++Local.calls[section];
+    Local.ticks[section] += ticks() - start;
+  }
+
+  Section section;
+  uint64_t start;
+};
+
+#endif
+
+} // namespace Profile
+
+// The timer is named after the line, so that scopes can be nested
+#ifdef USE_PROFILE
+#  define PROFILE_NAME(line) profileScope ## line
+#  define PROFILE_LINE(s, line) Profile::Scope PROFILE_NAME(line)(Profile::s)
+#  define PROFILE_SCOPE(s) PROFILE_LINE(s, __LINE__)
+#else
+#  define PROFILE_SCOPE(s)
+#endif
+
+#endif // #ifndef PROFILE_H_INCLUDED
@@ -19,13 +19,20 @@
 */
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <cstring>   // For std::memset
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <sstream>
+#include <vector>
 
+#include "cluster.h"
 #include "evaluate.h"
+#include "globals.h"
 #include "misc.h"
 #include "movegen.h"
 #include "movepick.h"
@@ -35,22 +42,9 @@
 #include "thread.h"
 #include "tt.h"
 #include "uci.h"
+#include "egtb/egtb.h"
 #include "syzygy/tbprobe.h"
 
-namespace Search {
-
-  LimitsType Limits;
-}
-
-namespace Tablebases {
-
-  int Cardinality;
-  bool RootInTB;
-  bool UseRule50;
-  Depth ProbeDepth;
-  Value Score;
-}
-
 namespace TB = Tablebases;
 
 using std::string;
@@ -79,12 +73,36 @@ namespace {
     return Reductions[PvNode][i][std::min(d / ONE_PLY, 63)][std::min(mn, 63)] * ONE_PLY;
   }
 
+  // Breadcrumbs are used to mark nodes as being searched by a given thread
+  struct Breadcrumb {
+    std::atomic<Thread*> thread;
+    std::atomic<Key> key;
+  };
+
   // History and stats update bonus, based on depth
   int stat_bonus(Depth depth) {
     int d = depth / ONE_PLY;
     return d > 17 ? 0 : d * d + 2 * d - 2;
   }
 
+  // insertion_sort() sorts the root moves like std::stable_sort(), which would
+  // allocate a temporary buffer. The moves are almost sorted, so an insertion
+  // sort moves only the few that changed.
+  void insertion_sort(RootMoves::iterator begin, RootMoves::iterator end) {
+
+    for (auto p = begin; p < end; ++p)
+    {
+        if (p == begin || !(*p < *(p - 1)))
+            continue;
+
+        RootMove tmp = *p;
+        auto q = p;
+        for ( ; q != begin && tmp < *(q - 1); --q)
+            *q = *(q - 1);
+        *q = tmp;
+    }
+  }
+
   // Skill structure is used to implement strength limit
   struct Skill {
     explicit Skill(int l) : level(l) {}
@@ -110,7 +128,7 @@ namespace {
       return expectedPosKey == key ? pv[2] : MOVE_NONE;
     }
 
-    void update(Position& pos, const std::vector<Move>& newPv) {
+    void update(Position& pos, const ValueList<Move, MAX_PLY + 1>& newPv) {
 
       assert(newPv.size() >= 3);
 
@@ -135,9 +153,6 @@ namespace {
     Move pv[3];
   };
 
-  EasyMoveManager EasyMove;
-  Value DrawValue[COLOR_NB];
-
   template <NodeType NT>
   Value search(Position& pos, Stack* ss, Value alpha, Value beta, Depth depth, bool cutNode, bool skipEarlyPruning);
 
@@ -150,30 +165,336 @@ namespace {
   void update_continuation_histories(Stack* ss, Piece pc, Square to, int bonus);
   void update_stats(const Position& pos, Stack* ss, Move move, Move* quiets, int quietsCnt, int bonus);
 
+  // PerftTable caches the leaf counts of perft subtrees, indexed by position
+  // key and depth, so that transpositions are counted only once. It is shared
+  // by all the threads without locks: an entry stores the count together with
+  // its key xor-ed with the count, so that an entry torn by a concurrent write
+  // is detected and discarded. It has the size set by the "Hash" option and is
+  // freed at the end of the run, not to keep that memory besides the TT.
+  class PerftTable {
+
+    struct Entry {
+      std::atomic<uint64_t> check, count;
+    };
+
+  public:
+    void resize(size_t mbSize) {
+      size_t count = 1;
+      while (2 * count * sizeof(Entry) <= mbSize * 1024 * 1024)
+          count *= 2;
+
+      if (count != size)
+      {
+          table.reset(new Entry[count]);
+          for (size_t i = 0; i < count; ++i)
+              table[i].check = table[i].count = 0;
+          size = count;
+      }
+    }
+
+    void free() {
+      table.reset();
+      size = 0;
+    }
+
+    bool probe(Key key, uint64_t& cnt) const {
+      const Entry& e = table[key & (size - 1)];
+      cnt = e.count.load(std::memory_order_relaxed);
+      return (e.check.load(std::memory_order_relaxed) ^ cnt) == key;
+    }
+
+    void store(Key key, uint64_t cnt) {
+      Entry& e = table[key & (size - 1)];
+      e.check.store(key ^ cnt, std::memory_order_relaxed);
+      e.count.store(cnt, std::memory_order_relaxed);
+    }
+
+  private:
+    std::unique_ptr<Entry[]> table;
+    size_t size = 0;
+  };
+
+} // namespace
+
+
+/// Search::State is what the threads of an engine instance share during a
+/// search, besides the limits: one of them exists per Engine.
+
+struct Search::State {
+  std::array<Breadcrumb, 1024> breadcrumbs;
+  bool useBreadcrumbs; // Set by the main thread before the helpers start
+  EasyMoveManager easyMoveManager;
+  PerftTable perftTT;
+  std::atomic<size_t> perftNext;
+  std::vector<uint64_t> perftCounts;
+  std::vector<std::string> batchFens;
+  std::atomic<size_t> batchNext, batchDone;
+
+  // Parallel MultiPV, the deepest line found for each PV index and their
+  // ranking without duplicates, see below.
+  struct Line { RootMove rm; Depth depth; };
+
+  size_t lineGroups; // Zero when the threads search all the lines
+  Mutex lineMutex;
+  std::vector<Line> lines, ranking;
+  std::vector<Depth> mergedDepth;
+  int rankingVersion, mergedVersion;
+
+  // Set at the root by Tablebases::filter_root_moves()
+  int tbCardinality;
+  bool rootInTB, tbUseRule50;
+  Depth tbProbeDepth;
+  Value tbScore;
+};
+
+std::shared_ptr<Search::State> Search::new_state() {
+  return std::make_shared<State>(); // Value-initialized, so zeroed
+}
+
+namespace {
+
+  // state() returns the search state of the engine of the calling thread
+  Search::State& state() { return *Engine::CurrentEngine->search; }
+
+  // With parallel MultiPV the threads are split into groups, and the threads
+  // of a group search one PV line of every lineGroups, after bringing to the
+  // front the best moves of the lines before it. As the groups see the lines
+  // of the others with some delay, two lines can end with the same move. So
+  // the lines are ranked by score, keeping the deeper one of a move, and the
+  // main thread reports this ranking.
+
+  typedef Search::State::Line Line;
+
+  // move_to() moves the given move to index i, keeping the order of the others.
+  // It returns false if the move is already before i.
+  bool move_to(RootMoves& rootMoves, size_t i, Move m) {
+
+    auto it = std::find(rootMoves.begin() + i, rootMoves.end(), m);
+    if (it == rootMoves.end())
+        return false;
+
+    std::rotate(rootMoves.begin() + i, it, it + 1);
+    return true;
+  }
+
+  void exclude_lines(RootMoves& rootMoves, size_t count) {
+
+    Search::State& s = state();
+    std::lock_guard<Mutex> lk(s.lineMutex);
+
+    for (size_t i = 0; i < count; ++i)
+        move_to(rootMoves, i, s.ranking[i].rm.pv[0]);
+  }
+
+  // publish_line() returns false if the line was searched with a stale view
+  // of the lines before it, that meanwhile found its best move.
+  bool publish_line(const RootMove& rm, size_t i, Depth depth) {
+
+    Search::State& s = state();
+    std::lock_guard<Mutex> lk(s.lineMutex);
+
+    for (size_t j = 0; j < i; ++j)
+        if (s.ranking[j].rm == rm.pv[0])
+            return false;
+
+    if (depth < s.lines[i].depth)
+        return true;
+
+    s.lines[i] = { rm, depth };
+
+    // Update the ranking with the lines. A move found at a previous iteration
+    // and by none of the lines now stays, but after the lines which are all
+    // newer, to fill the holes left by the duplicates.
+    for (const Line& line : s.lines)
+    {
+        auto it = std::find_if(s.ranking.begin(), s.ranking.end(),
+                               [&](const Line& l) { return l.rm == line.rm.pv[0]; });
+
+        if (it == s.ranking.end())
+            s.ranking.push_back(line);
+
+        else if (line.depth > it->depth)
+            *it = line;
+    }
+
+    Depth oldest = DEPTH_MAX;
+    for (const Line& line : s.lines)
+        oldest = std::min(oldest, line.depth);
+
+    auto better = [oldest](const Line& a, const Line& b) {
+        return (a.depth >= oldest) != (b.depth >= oldest) ? a.depth >= oldest : a.rm < b.rm;
+    };
+
+    for (size_t j = 1; j < s.ranking.size(); ++j)
+        for (size_t k = j; k > 0 && better(s.ranking[k], s.ranking[k - 1]); --k)
+            std::swap(s.ranking[k], s.ranking[k - 1]);
+
+    s.ranking.erase(s.ranking.begin() + s.lines.size(), s.ranking.end());
+    ++s.rankingVersion;
+    return true;
+  }
+
+  // merge_lines() copies the ranking to the root moves of the main thread. It
+  // returns true if the ranking changed since the last merge.
+  bool merge_lines(RootMoves& rootMoves) {
+
+    Search::State& s = state();
+    std::lock_guard<Mutex> lk(s.lineMutex);
+
+    for (size_t i = 0; i < s.ranking.size(); ++i)
+        if (move_to(rootMoves, i, s.ranking[i].rm.pv[0]))
+            rootMoves[i] = s.ranking[i].rm, s.mergedDepth[i] = s.ranking[i].depth;
+        else
+            s.mergedDepth[i] = DEPTH_ZERO; // Not reported
+
+    bool changed = s.mergedVersion != s.rankingVersion;
+    s.mergedVersion = s.rankingVersion;
+    return changed;
+  }
+
+  // ThreadHolding keeps track of which thread left breadcrumbs at the given
+  // node. A free node is marked upon entering the moves loop by the constructor,
+  // and unmarked upon leaving that loop by the destructor. Moves at a node that
+  // another thread is already searching are reduced more, so that the threads
+  // spread over different subtrees.
+  struct ThreadHolding {
+    explicit ThreadHolding(Thread* thisThread, Key posKey, int ply) {
+       Search::State& s = state();
+       location = s.useBreadcrumbs && ply < 8 ? &s.breadcrumbs[posKey & (s.breadcrumbs.size() - 1)] : nullptr;
+       otherThread = false;
+       owning = false;
+       if (location)
+       {
+          // See if another already marked this location, if not, mark it ourselves
+          Thread* tmp = location->thread.load(std::memory_order_relaxed);
+          if (tmp == nullptr)
+          {
+              location->thread.store(thisThread, std::memory_order_relaxed);
+              location->key.store(posKey, std::memory_order_relaxed);
+              owning = true;
+          }
+          else if (   tmp != thisThread
+                   && location->key.load(std::memory_order_relaxed) == posKey)
+              otherThread = true;
+       }
+    }
+
+    ~ThreadHolding() {
+       if (owning) // Free the marked location
+           location->thread.store(nullptr, std::memory_order_relaxed);
+    }
+
+    bool marked() const { return otherThread; }
+
+  private:
+    Breadcrumb* location;
+    bool otherThread, owning;
+  };
+
+
   // perft() is our utility to verify move generation. All the leaf nodes up
   // to the given depth are generated and counted, and the sum is returned.
-  template<bool Root>
+  // Subtree counts are cached in the perft table of the engine.
   uint64_t perft(Position& pos, Depth depth) {
 
     StateInfo st;
     uint64_t cnt, nodes = 0;
     const bool leaf = (depth == 2 * ONE_PLY);
+    const Key key = pos.key() ^ (uint64_t(depth / ONE_PLY) * 0x9E3779B97F4A7C15ULL);
+
+    if (state().perftTT.probe(key, cnt))
+        return cnt;
 
     for (const auto& m : MoveList<LEGAL>(pos))
     {
-        if (Root && depth <= ONE_PLY)
-            cnt = 1, nodes++;
-        else
+        pos.do_move(m, st);
+        nodes += leaf ? count_legal(pos) : perft(pos, depth - ONE_PLY);
+        pos.undo_move(m);
+    }
+
+    state().perftTT.store(key, nodes);
+    return nodes;
+  }
+
+  // perft_root() is run by every thread for "go perft": root moves are handed
+  // out one at a time through perftNext and their counts saved in perftCounts,
+  // that the main thread prints when all the threads are done.
+  void perft_root(Thread* th) {
+
+    StateInfo st;
+    Search::State& s = state();
+    Position& pos = th->rootPos;
+    const Depth depth = Limits.perft * ONE_PLY;
+    size_t i;
+
+    while ((i = s.perftNext++) < th->rootMoves.size())
+    {
+        Move m = th->rootMoves[i].pv[0];
+        uint64_t cnt = 1;
+
+        if (depth > ONE_PLY)
         {
             pos.do_move(m, st);
-            cnt = leaf ? MoveList<LEGAL>(pos).size() : perft<false>(pos, depth - ONE_PLY);
-            nodes += cnt;
+            cnt = depth == 2 * ONE_PLY ? count_legal(pos) : perft(pos, depth - ONE_PLY);
             pos.undo_move(m);
         }
-        if (Root)
-            sync_cout << UCI::move(m) << ": " << cnt << sync_endl;
+
+        s.perftCounts[i] = cnt;
     }
-    return nodes;
+  }
+
+  // batch_root() is run by every thread for the "batch" command: like for
+  // perft, the positions are handed out one at a time through batchNext. Each
+  // of them is searched to the given depth by a single thread, that prints the
+  // result as soon as it is done. A stopped search gives no result.
+  void batch_root(Thread* th) {
+
+    StateInfo st;
+    Search::State& s = state();
+    size_t i;
+
+    th->inBatch = true;
+
+    while (!Threads.stop && (i = s.batchNext++) < s.batchFens.size())
+    {
+        th->rootPos.set(s.batchFens[i], Threads.rootChess960, &st, th);
+        th->rootMoves.clear();
+
+        for (const auto& m : MoveList<LEGAL>(th->rootPos))
+            th->rootMoves.emplace_back(m);
+
+        uint64_t nodes = th->nodes;
+        Value v = th->rootPos.checkers() ? -VALUE_MATE : VALUE_DRAW;
+
+        if (!th->rootMoves.empty())
+        {
+            th->rootDepth = th->completedDepth = DEPTH_ZERO;
+            th->Thread::search();
+            v = th->rootMoves[0].score;
+        }
+
+        if (Threads.stop)
+            break;
+
+        std::stringstream ss;
+        ss << "batch " << i
+           << " bestmove " << UCI::move(th->rootMoves.empty() ? MOVE_NONE : th->rootMoves[0].pv[0])
+           << " score "    << UCI::value(v)
+           << " depth "    << th->completedDepth / ONE_PLY
+           << " nodes "    << th->nodes - nodes;
+
+        if (!th->rootMoves.empty())
+        {
+            ss << " pv";
+            for (Move m : th->rootMoves[0].pv)
+                ss << " " << UCI::move(m);
+        }
+
+        sync_cout << ss.str() << sync_endl;
+        ++s.batchDone;
+    }
+
+    th->inBatch = false;
   }
 
 } // namespace
@@ -211,7 +532,7 @@ void Search::clear() {
 
   Threads.main()->wait_for_search_finished();
 
-  Time.availableNodes = 0;
+  Time.clear();
   TT.clear();
 
   for (Thread* th : Threads)
@@ -229,7 +550,35 @@ void MainThread::search() {
 
   if (Limits.perft)
   {
-      nodes = perft<true>(rootPos, Limits.perft * ONE_PLY);
+      state().perftTT.resize(Options["Hash"]);
+      state().perftCounts.assign(rootMoves.size(), 0);
+      state().perftNext = 0;
+
+      for (Thread* th : Threads)
+          if (th != this)
+              th->start_searching();
+
+      perft_root(this);
+
+      for (Thread* th : Threads)
+          if (th != this)
+              th->wait_for_search_finished();
+
+      state().perftTT.free();
+
+      // The node counters were also increased by do_move(), overwrite them
+      // with the perft total, that is reported by bench.
+      for (Thread* th : Threads)
+          th->nodes = 0;
+
+      nodes = 0;
+      for (size_t i = 0; i < rootMoves.size(); ++i)
+      {
+          if (Limits.divide)
+              sync_cout << UCI::move(rootMoves[i].pv[0]) << ": " << state().perftCounts[i] << sync_endl;
+          nodes += state().perftCounts[i];
+      }
+
       sync_cout << "\nNodes searched: " << nodes << "\n" << sync_endl;
       return;
   }
@@ -238,9 +587,43 @@ void MainThread::search() {
   Time.init(Limits, us, rootPos.game_ply());
   TT.new_search();
 
-  int contempt = Options["Contempt"] * PawnValueEg / 100; // From centipawns
-  DrawValue[ us] = VALUE_DRAW - Value(contempt);
-  DrawValue[~us] = VALUE_DRAW + Value(contempt);
+  state().useBreadcrumbs = Options["Breadcrumbs"] && Threads.size() > 1 && Limits.batch.empty();
+  state().lineGroups = 0;
+
+  if (!Limits.batch.empty())
+  {
+      Search::State& s = state();
+      std::ifstream file(Limits.batch);
+      std::string fen;
+
+      s.batchFens.clear();
+      s.batchNext = s.batchDone = 0;
+
+      while (std::getline(file, fen))
+          if (!fen.empty())
+              s.batchFens.push_back(fen);
+
+      if (!file.eof())
+          sync_cout << "info string Unable to read file " << Limits.batch << sync_endl;
+
+      // The pool root was probed by filter_root_moves(), the positions of the
+      // batch are not, so probe the Syzygy tables during their searches.
+      s.rootInTB = false;
+      s.tbCardinality = std::min(int(Options["SyzygyProbeLimit"]), Tablebases::MaxCardinality);
+
+      for (Thread* th : Threads)
+          if (th != this)
+              th->start_searching();
+
+      batch_root(this);
+
+      for (Thread* th : Threads)
+          if (th != this)
+              th->wait_for_search_finished();
+
+      sync_cout << "batch done " << s.batchDone << sync_endl;
+      return;
+  }
 
   if (rootMoves.empty())
   {
@@ -251,11 +634,33 @@ void MainThread::search() {
   }
   else
   {
+      Search::State& s = state();
+      size_t multiPV = std::min(size_t(Options["MultiPV"]), rootMoves.size());
+
+      s.lineGroups =   Options["Parallel MultiPV"] && multiPV > 1 && Threads.size() > 1
+                    && !Skill(Options["Skill Level"]).enabled() ? std::min(multiPV, Threads.size()) : 0;
+      s.lines.clear();
+      for (size_t i = 0; i < multiPV; ++i)
+          s.lines.push_back({ rootMoves[i], DEPTH_ZERO });
+
+      s.ranking = s.lines; // The threads start from the same move ordering
+      s.mergedDepth.assign(multiPV, DEPTH_ZERO);
+      s.rankingVersion = s.mergedVersion = 0;
+
+      Cluster::start();
+
       for (Thread* th : Threads)
           if (th != this)
               th->start_searching();
 
       Thread::search(); // Let's start searching!
+
+      // With parallel MultiPV the helpers also stop at the depth limit, let
+      // them complete the other lines.
+      if (Limits.depth && s.lineGroups)
+          for (Thread* th : Threads)
+              if (th != this)
+                  th->wait_for_search_finished();
   }
 
   // When we reach the maximum depth, we can arrive here without a raise of
@@ -282,13 +687,16 @@ void MainThread::search() {
   if (Limits.npmsec)
       Time.availableNodes += Limits.inc[us] - Threads.nodes_searched();
 
+  Time.finish(Threads.nodes_searched());
+
   // Check if there are threads with a better score than main thread
   Thread* bestThread = this;
-  if (   !this->easyMovePlayed
-      &&  Options["MultiPV"] == 1
-      && !Limits.depth
-      && !Skill(Options["Skill Level"]).enabled()
-      &&  rootMoves[0].pv[0] != MOVE_NONE)
+  bool vote =   !this->easyMovePlayed
+             &&  Options["MultiPV"] == 1
+             && !Limits.depth
+             && !Skill(Options["Skill Level"]).enabled()
+             &&  rootMoves[0].pv[0] != MOVE_NONE;
+  if (vote)
   {
       for (Thread* th : Threads)
       {
@@ -304,16 +712,36 @@ void MainThread::search() {
 
   previousScore = bestThread->rootMoves[0].score;
 
+  // Stop the nodes of the cluster, and pick the result of one of them in
+  // the same way, if it is better.
+  const Cluster::Result* node = Cluster::stop();
+  if (   node && vote
+      && node->score > previousScore
+      && (node->depth >= bestThread->completedDepth || node->score >= VALUE_MATE_IN_MAX_PLY))
+  {
+      previousScore = node->score;
+      sync_cout << "info depth " << node->depth / ONE_PLY << " score " << UCI::value(node->score)
+                << " pv " << node->bestMove << (node->ponder.empty() ? "" : " " + node->ponder) << sync_endl;
+      sync_cout << "bestmove " << node->bestMove
+                << (node->ponder.empty() ? "" : " ponder " + node->ponder) << sync_endl;
+      return;
+  }
+
+  // A worker reports its exact result to the master of the cluster
+  if (Cluster::Index)
+      sync_cout << "result " << bestThread->completedDepth << ' '
+                << bestThread->rootMoves[0].score << sync_endl;
+
   // Send new PV when needed
-  if (bestThread != this)
+  if (bestThread != this || (state().lineGroups && merge_lines(rootMoves)))
       sync_cout << UCI::pv(bestThread->rootPos, bestThread->completedDepth, -VALUE_INFINITE, VALUE_INFINITE) << sync_endl;
 
-  sync_cout << "bestmove " << UCI::move(bestThread->rootMoves[0].pv[0]);
+  string ponder;
 
   if (bestThread->rootMoves[0].pv.size() > 1 || bestThread->rootMoves[0].extract_ponder_from_tt(rootPos))
-      std::cout << " ponder " << UCI::move(bestThread->rootMoves[0].pv[1]);
+      ponder = " ponder " + UCI::move(bestThread->rootMoves[0].pv[1]);
 
-  std::cout << sync_endl;
+  sync_cout << "bestmove " << UCI::move(bestThread->rootMoves[0].pv[0]) << ponder << sync_endl;
 }
 
 
@@ -323,10 +751,16 @@ void MainThread::search() {
 
 void Thread::search() {
 
+  if (Limits.perft)
+      return perft_root(this);
+
+  if (!Limits.batch.empty() && !inBatch)
+      return batch_root(this);
+
   Stack stack[MAX_PLY+7], *ss = stack+4; // To reference from (ss-4) to (ss+2)
   Value bestValue, alpha, beta, delta;
   Move easyMove = MOVE_NONE;
-  MainThread* mainThread = (this == Threads.main() ? Threads.main() : nullptr);
+  MainThread* mainThread = (this == Threads.main() && !inBatch ? Threads.main() : nullptr);
 
   std::memset(ss-4, 0, 7 * sizeof(Stack));
   for (int i = 4; i > 0; i--)
@@ -335,10 +769,18 @@ void Thread::search() {
   bestValue = delta = alpha = -VALUE_INFINITE;
   beta = VALUE_INFINITE;
 
+  size_t groups = state().lineGroups, step = std::max(groups, size_t(1));
+  size_t group = groups ? idx % groups : 0, rank = groups ? idx / groups : idx;
+
+  Color us = rootPos.side_to_move();
+  int contempt = Options["Contempt"] * PawnValueEg / 100; // From centipawns
+  drawValue[ us] = VALUE_DRAW - Value(contempt);
+  drawValue[~us] = VALUE_DRAW + Value(contempt);
+
   if (mainThread)
   {
-      easyMove = EasyMove.get(rootPos.key());
-      EasyMove.clear();
+      easyMove = state().easyMoveManager.get(rootPos.key());
+      state().easyMoveManager.clear();
       mainThread->easyMovePlayed = mainThread->failedLow = false;
       mainThread->bestMoveChanges = 0;
   }
@@ -356,12 +798,13 @@ void Thread::search() {
   // Iterative deepening loop until requested to stop or the target depth is reached
   while (   (rootDepth += ONE_PLY) < DEPTH_MAX
          && !Threads.stop
-         && !(Limits.depth && mainThread && rootDepth / ONE_PLY > Limits.depth))
+         && !(Limits.depth && (mainThread || inBatch || groups) && rootDepth / ONE_PLY > Limits.depth))
   {
-      // Distribute search depths across the threads
-      if (idx)
+      // Distribute search depths across the threads of a group, and the nodes
+      // of a cluster, unless each one searches its own position of a batch.
+      if ((rank || Cluster::Index) && !inBatch)
       {
-          int i = (idx - 1) % 20;
+          int i = (rank + Cluster::Index * Threads.size() - 1) % 20;
           if (((rootDepth / ONE_PLY + rootPos.game_ply() + skipPhase[i]) / skipSize[i]) % 2)
               continue;
       }
@@ -375,12 +818,19 @@ void Thread::search() {
       for (RootMove& rm : rootMoves)
           rm.previousScore = rm.score;
 
-      // MultiPV loop. We perform a full root search for each PV line
-      for (PVIdx = 0; PVIdx < multiPV && !Threads.stop; ++PVIdx)
+      // MultiPV loop. We perform a full root search for each PV line, or for
+      // the lines of our group with parallel MultiPV, where a line searched
+      // with a stale view of the others is searched again, once.
+      bool redo = false;
+
+      for (PVIdx = group; PVIdx < multiPV && !Threads.stop; PVIdx += redo ? 0 : step)
       {
           // Reset UCI info selDepth for each depth and each PV line
           selDepth = 0;
 
+          if (groups)
+              exclude_lines(rootMoves, PVIdx);
+
           // Reset aspiration window starting size
           if (rootDepth >= 5 * ONE_PLY)
           {
@@ -402,7 +852,7 @@ void Thread::search() {
               // and we want to keep the same order for all the moves except the
               // new PV that goes to the front. Note that in case of MultiPV
               // search the already searched PV lines are preserved.
-              std::stable_sort(rootMoves.begin() + PVIdx, rootMoves.end());
+              insertion_sort(rootMoves.begin() + PVIdx, rootMoves.end());
 
               // If search has been stopped, we break immediately. Sorting and
               // writing PV back to TT is safe because RootMoves is still
@@ -442,11 +892,20 @@ void Thread::search() {
           }
 
           // Sort the PV lines searched so far and update the GUI
-          std::stable_sort(rootMoves.begin(), rootMoves.begin() + PVIdx + 1);
+          if (!groups)
+              insertion_sort(rootMoves.begin(), rootMoves.begin() + PVIdx + 1);
+
+          else if (!Threads.stop)
+              redo = !publish_line(rootMoves[PVIdx], PVIdx, rootDepth) && !redo;
 
           if (    mainThread
-              && (Threads.stop || PVIdx + 1 == multiPV || Time.elapsed() > 3000))
+              && (Threads.stop || PVIdx + step >= multiPV || Time.elapsed() > 3000))
+          {
+              if (groups)
+                  merge_lines(rootMoves);
+
               sync_cout << UCI::pv(rootPos, rootDepth, alpha, beta) << sync_endl;
+          }
       }
 
       if (!Threads.stop)
@@ -497,9 +956,9 @@ void Thread::search() {
           }
 
           if (rootMoves[0].pv.size() >= 3)
-              EasyMove.update(rootPos, rootMoves[0].pv);
+              state().easyMoveManager.update(rootPos, rootMoves[0].pv);
           else
-              EasyMove.clear();
+              state().easyMoveManager.clear();
       }
   }
 
@@ -508,8 +967,8 @@ void Thread::search() {
 
   // Clear any candidate easy move that wasn't stable for the last search
   // iterations; the second condition prevents consecutive fast moves.
-  if (EasyMove.stableCnt < 6 || mainThread->easyMovePlayed)
-      EasyMove.clear();
+  if (state().easyMoveManager.stableCnt < 6 || mainThread->easyMovePlayed)
+      state().easyMoveManager.clear();
 
   // If skill level is enabled, swap best PV line with the sub-optimal one
   if (skill.enabled())
@@ -528,6 +987,18 @@ namespace {
     const bool PvNode = NT == PV;
     const bool rootNode = PvNode && ss->ply == 0;
 
+    // Check if we have an upcoming move which draws by repetition, or
+    // if the opponent had an alternative move earlier to this position.
+    if (   pos.rule50_count() >= 3
+        && alpha < pos.this_thread()->drawValue[pos.side_to_move()]
+        && !rootNode
+        && pos.has_game_cycle(ss->ply))
+    {
+        alpha = pos.this_thread()->drawValue[pos.side_to_move()];
+        if (alpha >= beta)
+            return alpha;
+    }
+
     assert(-VALUE_INFINITE <= alpha && alpha < beta && beta <= VALUE_INFINITE);
     assert(PvNode || (alpha == beta - 1));
     assert(DEPTH_ZERO < depth && depth < DEPTH_MAX);
@@ -566,7 +1037,7 @@ namespace {
         // Step 2. Check for aborted search and immediate draw
         if (Threads.stop.load(std::memory_order_relaxed) || pos.is_draw(ss->ply) || ss->ply >= MAX_PLY)
             return ss->ply >= MAX_PLY && !inCheck ? evaluate(pos)
-                                                  : DrawValue[pos.side_to_move()];
+                                                  : thisThread->drawValue[pos.side_to_move()];
 
         // Step 3. Mate distance pruning. Even if we mate at the next move our score
         // would be at best mate_in(ss->ply+1), but if alpha is already bigger because
@@ -598,11 +1069,13 @@ namespace {
     ttMove =  rootNode ? thisThread->rootMoves[thisThread->PVIdx].pv[0]
             : ttHit    ? tte->move() : MOVE_NONE;
 
-    // At non-PV nodes we check for an early TT cutoff
+    // At non-PV nodes we check for an early TT cutoff, but not when in check
+    // past the count: the value does not hold for the draw we return below.
     if (  !PvNode
         && ttHit
         && tte->depth() >= depth
         && ttValue != VALUE_NONE // Possible in case of TT access race
+        && !(inCheck && pos.counting_draw())
         && (ttValue >= beta ? (tte->bound() & BOUND_LOWER)
                             : (tte->bound() & BOUND_UPPER)))
     {
@@ -630,12 +1103,14 @@ namespace {
     }
 
     // Step 4a. Tablebase probe
-    if (!rootNode && TB::Cardinality)
+    const Search::State& shared = state();
+
+    if (!rootNode && shared.tbCardinality)
     {
         int piecesCount = pos.count<ALL_PIECES>();
 
-        if (    piecesCount <= TB::Cardinality
-            && (piecesCount <  TB::Cardinality || depth >= TB::ProbeDepth)
+        if (    piecesCount <= shared.tbCardinality
+            && (piecesCount <  shared.tbCardinality || depth >= shared.tbProbeDepth)
             &&  pos.rule50_count() == 0)
         {
             TB::ProbeState err;
@@ -645,7 +1120,7 @@ namespace {
             {
                 thisThread->tbHits.fetch_add(1, std::memory_order_relaxed);
 
-                int drawScore = TB::UseRule50 ? 1 : 0;
+                int drawScore = shared.tbUseRule50 ? 1 : 0;
 
                 value =  v < -drawScore ? -VALUE_MATE + MAX_PLY + ss->ply + 1
                        : v >  drawScore ?  VALUE_MATE - MAX_PLY - ss->ply - 1
@@ -660,6 +1135,27 @@ namespace {
         }
     }
 
+    // Makruk tablebases hold the exact distance to mate, but a draw by the
+    // counting rules may be only a bound, see EGTB::probe().
+    Bound tbBound;
+
+    if (    !rootNode
+        &&  EGTB::MaxCardinality >= pos.count<ALL_PIECES>()
+        &&  EGTB::probe(pos, ss->ply, value, tbBound))
+    {
+        thisThread->tbHits.fetch_add(1, std::memory_order_relaxed);
+
+        if (    tbBound == BOUND_EXACT
+            || (tbBound == BOUND_LOWER ? value >= beta : value <= alpha))
+        {
+            tte->save(posKey, value_to_tt(value, ss->ply), tbBound,
+                      std::min(DEPTH_MAX - ONE_PLY, depth + 6 * ONE_PLY),
+                      MOVE_NONE, VALUE_NONE, TT.generation());
+
+            return value;
+        }
+    }
+
     // Step 5. Evaluate the position statically
     if (inCheck)
     {
@@ -765,18 +1261,17 @@ namespace {
         MovePicker mp(pos, ttMove, rbeta - ss->staticEval);
 
         while ((move = mp.next_move()) != MOVE_NONE)
-            if (pos.legal(move))
-            {
-                ss->currentMove = move;
-                ss->contHistory = &thisThread->contHistory[pos.moved_piece(move)][to_sq(move)];
-
-                assert(depth >= 5 * ONE_PLY);
-                pos.do_move(move, st);
-                value = -search<NonPV>(pos, ss+1, -rbeta, -rbeta+1, depth - 4 * ONE_PLY, !cutNode, false);
-                pos.undo_move(move);
-                if (value >= rbeta)
-                    return value;
-            }
+        {
+            ss->currentMove = move;
+            ss->contHistory = &thisThread->contHistory[pos.moved_piece(move)][to_sq(move)];
+
+            assert(depth >= 5 * ONE_PLY);
+            pos.do_move(move, st);
+            value = -search<NonPV>(pos, ss+1, -rbeta, -rbeta+1, depth - 4 * ONE_PLY, !cutNode, false);
+            pos.undo_move(move);
+            if (value >= rbeta)
+                return value;
+        }
     }
 
     // Step 10. Internal iterative deepening (skipped when in check)
@@ -793,6 +1288,9 @@ namespace {
 
 moves_loop: // When in check search starts from here
 
+    // Mark this node as being searched
+    ThreadHolding th(thisThread, posKey, ss->ply);
+
     const PieceToHistory* contHist[] = { (ss-1)->contHistory, (ss-2)->contHistory, nullptr, (ss-4)->contHistory };
     Move countermove = thisThread->counterMoves[pos.piece_on(prevSq)][prevSq];
 
@@ -831,7 +1329,7 @@ moves_loop: // When in check search starts from here
 
       ss->moveCount = ++moveCount;
 
-      if (rootNode && thisThread == Threads.main() && Time.elapsed() > 3000)
+      if (rootNode && thisThread == Threads.main() && !thisThread->inBatch && Time.elapsed() > 3000)
           sync_cout << "info depth " << depth / ONE_PLY
                     << " currmove " << UCI::move(move)
                     << " currmovenumber " << moveCount + thisThread->PVIdx << sync_endl;
@@ -858,8 +1356,7 @@ moves_loop: // When in check search starts from here
       // on all the other moves but the ttMove and if the result is lower than
       // ttValue minus a margin then we will extend the ttMove.
       if (    singularExtensionNode
-          &&  move == ttMove
-          &&  pos.legal(move))
+          &&  move == ttMove)
       {
           Value rBeta = std::max(ttValue - 2 * depth / ONE_PLY, -VALUE_MATE);
           Depth d = (depth / (2 * ONE_PLY)) * ONE_PLY;
@@ -923,12 +1420,7 @@ moves_loop: // When in check search starts from here
       // Speculative prefetch as early as possible
       prefetch(TT.first_entry(pos.key_after(move)));
 
-      // Check for legality just before making the move
-      if (!rootNode && !pos.legal(move))
-      {
-          ss->moveCount = --moveCount;
-          continue;
-      }
+      assert(pos.legal(move)); // MovePicker returns only legal moves
 
       if (move == ttMove && captureOrPromotion)
           ttCapture = true;
@@ -964,6 +1456,10 @@ moves_loop: // When in check search starts from here
               if (ttCapture)
                   r += ONE_PLY;
 
+              // Increase reduction if other threads are searching this position
+              if (th.marked())
+                  r += ONE_PLY;
+
               // Increase reduction for cut nodes
               if (cutNode)
                   r += 2 * ONE_PLY;
@@ -1077,6 +1573,8 @@ moves_loop: // When in check search starts from here
               else
               {
                   assert(value >= beta); // Fail high
+                  STATS_INC(BETA_CUTOFF);
+                  STATS_CUTOFF(moveCount - 1);
                   break;
               }
           }
@@ -1103,7 +1601,13 @@ moves_loop: // When in check search starts from here
 
     if (!moveCount)
         bestValue = excludedMove ? alpha
-                   :     inCheck ? mated_in(ss->ply) : DrawValue[pos.side_to_move()];
+                   :     inCheck ? mated_in(ss->ply) : thisThread->drawValue[pos.side_to_move()];
+
+    // Not mated, so a draw by the counting rules (see Position::is_draw()). It
+    // depends on the count, not on the position only, so it is not stored.
+    else if (inCheck && pos.counting_draw())
+        return thisThread->drawValue[pos.side_to_move()];
+
     else if (bestMove)
     {
         // Quiet best move: update move sorting heuristics
@@ -1121,10 +1625,11 @@ moves_loop: // When in check search starts from here
         update_continuation_histories(ss-1, pos.piece_on(prevSq), prevSq, stat_bonus(depth));
 
     if (!excludedMove)
-        tte->save(posKey, value_to_tt(bestValue, ss->ply),
-                  bestValue >= beta ? BOUND_LOWER :
-                  PvNode && bestMove ? BOUND_EXACT : BOUND_UPPER,
-                  depth, bestMove, ss->staticEval, TT.generation());
+    {
+        Bound b = bestValue >= beta ? BOUND_LOWER : PvNode && bestMove ? BOUND_EXACT : BOUND_UPPER;
+        tte->save(posKey, value_to_tt(bestValue, ss->ply), b, depth, bestMove, ss->staticEval, TT.generation());
+        Cluster::save(posKey, value_to_tt(bestValue, ss->ply), b, depth, bestMove, ss->staticEval);
+    }
 
     assert(bestValue > -VALUE_INFINITE && bestValue < VALUE_INFINITE);
 
@@ -1140,6 +1645,16 @@ moves_loop: // When in check search starts from here
 
     const bool PvNode = NT == PV;
 
+    // Same upcoming repetition check as in search()
+    if (   pos.rule50_count() >= 3
+        && alpha < pos.this_thread()->drawValue[pos.side_to_move()]
+        && pos.has_game_cycle(ss->ply))
+    {
+        alpha = pos.this_thread()->drawValue[pos.side_to_move()];
+        if (alpha >= beta)
+            return alpha;
+    }
+
     assert(InCheck == !!pos.checkers());
     assert(alpha >= -VALUE_INFINITE && alpha < beta && beta <= VALUE_INFINITE);
     assert(PvNode || (alpha == beta - 1));
@@ -1152,7 +1667,7 @@ moves_loop: // When in check search starts from here
     Key posKey;
     Move ttMove, move, bestMove;
     Value bestValue, value, ttValue, futilityValue, futilityBase, oldAlpha;
-    bool ttHit, givesCheck, evasionPrunable;
+    bool ttHit, givesCheck, evasionPrunable, countingDraw;
     Depth ttDepth;
     int moveCount;
 
@@ -1166,11 +1681,12 @@ moves_loop: // When in check search starts from here
     ss->currentMove = bestMove = MOVE_NONE;
     (ss+1)->ply = ss->ply + 1;
     moveCount = 0;
+    countingDraw = InCheck && pos.counting_draw();
 
     // Check for an instant draw or if the maximum ply has been reached
     if (pos.is_draw(ss->ply) || ss->ply >= MAX_PLY)
         return ss->ply >= MAX_PLY && !InCheck ? evaluate(pos)
-                                              : DrawValue[pos.side_to_move()];
+                                              : pos.this_thread()->drawValue[pos.side_to_move()];
 
     assert(0 <= ss->ply && ss->ply < MAX_PLY);
 
@@ -1189,6 +1705,7 @@ moves_loop: // When in check search starts from here
         && ttHit
         && tte->depth() >= ttDepth
         && ttValue != VALUE_NONE // Only in case of TT access race
+        && !countingDraw
         && (ttValue >= beta ? (tte->bound() &  BOUND_LOWER)
                             : (tte->bound() &  BOUND_UPPER)))
         return ttValue;
@@ -1286,12 +1803,7 @@ moves_loop: // When in check search starts from here
       // Speculative prefetch as early as possible
       prefetch(TT.first_entry(pos.key_after(move)));
 
-      // Check for legality just before making the move
-      if (!pos.legal(move))
-      {
-          moveCount--;
-          continue;
-      }
+      assert(pos.legal(move)); // MovePicker returns only legal moves
 
       ss->currentMove = move;
 
@@ -1318,6 +1830,9 @@ moves_loop: // When in check search starts from here
                   alpha = value;
                   bestMove = move;
               }
+              else if (countingDraw) // Not mated, the draw is returned below
+                  break;
+
               else // Fail high
               {
                   tte->save(posKey, value_to_tt(value, ss->ply), BOUND_LOWER,
@@ -1334,6 +1849,10 @@ moves_loop: // When in check search starts from here
     if (InCheck && bestValue == -VALUE_INFINITE)
         return mated_in(ss->ply); // Plies to mate from the root
 
+    // Not mated, so a draw by the counting rules, not stored as in search()
+    if (countingDraw)
+        return pos.this_thread()->drawValue[pos.side_to_move()];
+
     tte->save(posKey, value_to_tt(bestValue, ss->ply),
               PvNode && bestValue > oldAlpha ? BOUND_EXACT : BOUND_UPPER,
               ttDepth, bestMove, ss->staticEval, TT.generation());
@@ -1464,11 +1983,20 @@ moves_loop: // When in check search starts from here
     if (--callsCnt > 0)
         return;
 
-    // At low node count increase the checking rate to about 0.1% of nodes
-    // otherwise use a default value.
-    callsCnt = Limits.nodes ? std::min(4096, int(Limits.nodes / 1024)) : 4096;
+    // At low node count increase the checking rate to about 0.1% of nodes,
+    // otherwise check about every millisecond at the measured speed.
+    int perMs = int(Time.nps() / 1000 / int64_t(Threads.size()));
+    callsCnt = Limits.nodes ? std::min(4096, int(Limits.nodes / 1024))
+              : perMs       ? std::max(256, std::min(4096, perMs)) : 4096;
 
-    static TimePoint lastInfoTime = now();
+    // Near the end of a node budget check more often, so that the threads all
+    // together do not exceed it.
+    if (Limits.nodes || (Limits.npmsec && Limits.use_time_management()))
+    {
+        int64_t left = Limits.nodes ? Limits.nodes - int64_t(Threads.nodes_searched())
+                                    : int64_t(Time.maximum()) - Time.elapsed();
+        callsCnt = int(std::max(int64_t(1), std::min(int64_t(callsCnt), left / int64_t(Threads.size()))));
+    }
 
     int elapsed = Time.elapsed();
     TimePoint tick = Limits.startTime + elapsed;
@@ -1501,20 +2029,24 @@ string UCI::pv(const Position& pos, Depth depth, Value alpha, Value beta) {
   size_t PVIdx = pos.this_thread()->PVIdx;
   size_t multiPV = std::min((size_t)Options["MultiPV"], rootMoves.size());
   uint64_t nodesSearched = Threads.nodes_searched();
-  uint64_t tbHits = Threads.tb_hits() + (TB::RootInTB ? rootMoves.size() : 0);
+  uint64_t tbHits = Threads.tb_hits() + (state().rootInTB ? rootMoves.size() : 0);
+
+  size_t groups = state().lineGroups;
 
   for (size_t i = 0; i < multiPV; ++i)
   {
-      bool updated = (i <= PVIdx && rootMoves[i].score != -VALUE_INFINITE);
+      // With parallel MultiPV each line has the depth of its merged search
+      bool updated = groups ? state().mergedDepth[i] > DEPTH_ZERO
+                            : i <= PVIdx && rootMoves[i].score != -VALUE_INFINITE;
 
-      if (depth == ONE_PLY && !updated)
+      if ((depth == ONE_PLY || groups) && !updated)
           continue;
 
-      Depth d = updated ? depth : depth - ONE_PLY;
+      Depth d = groups ? state().mergedDepth[i] : updated ? depth : depth - ONE_PLY;
       Value v = updated ? rootMoves[i].score : rootMoves[i].previousScore;
 
-      bool tb = TB::RootInTB && abs(v) < VALUE_MATE - MAX_PLY;
-      v = tb ? TB::Score : v;
+      bool tb = state().rootInTB && abs(v) < VALUE_MATE - MAX_PLY;
+      v = tb ? state().tbScore : v;
 
       if (ss.rdbuf()->in_avail()) // Not at first line
           ss << "\n";
@@ -1577,40 +2109,52 @@ bool RootMove::extract_ponder_from_tt(Position& pos) {
 
 void Tablebases::filter_root_moves(Position& pos, Search::RootMoves& rootMoves) {
 
-    RootInTB = false;
-    UseRule50 = Options["Syzygy50MoveRule"];
-    ProbeDepth = Options["SyzygyProbeDepth"] * ONE_PLY;
-    Cardinality = Options["SyzygyProbeLimit"];
+    Search::State& s = state();
+
+    s.rootInTB = false;
+    s.tbUseRule50 = Options["Syzygy50MoveRule"];
+    s.tbProbeDepth = Options["SyzygyProbeDepth"] * ONE_PLY;
+    s.tbCardinality = Options["SyzygyProbeLimit"];
+
+    // The Makruk tables take precedence, keeping only the moves with the best
+    // distance to mate.
+    if (   EGTB::MaxCardinality >= popcount(pos.pieces())
+        && EGTB::root_probe(pos, rootMoves, s.tbScore))
+    {
+        s.rootInTB = true;
+        s.tbCardinality = 0;
+        return;
+    }
 
     // Skip TB probing when no TB found: !TBLargest -> !TB::Cardinality
-    if (Cardinality > MaxCardinality)
+    if (s.tbCardinality > MaxCardinality)
     {
-        Cardinality = MaxCardinality;
-        ProbeDepth = DEPTH_ZERO;
+        s.tbCardinality = MaxCardinality;
+        s.tbProbeDepth = DEPTH_ZERO;
     }
 
-    if (Cardinality < popcount(pos.pieces()))
+    if (s.tbCardinality < popcount(pos.pieces()))
         return;
 
     // If the current root position is in the tablebases, then RootMoves
     // contains only moves that preserve the draw or the win.
-    RootInTB = root_probe(pos, rootMoves, TB::Score);
+    s.rootInTB = root_probe(pos, rootMoves, s.tbScore);
 
-    if (RootInTB)
-        Cardinality = 0; // Do not probe tablebases during the search
+    if (s.rootInTB)
+        s.tbCardinality = 0; // Do not probe tablebases during the search
 
     else // If DTZ tables are missing, use WDL tables as a fallback
     {
         // Filter out moves that do not preserve the draw or the win.
-        RootInTB = root_probe_wdl(pos, rootMoves, TB::Score);
+        s.rootInTB = root_probe_wdl(pos, rootMoves, s.tbScore);
 
         // Only probe during search if winning
-        if (RootInTB && TB::Score <= VALUE_DRAW)
-            Cardinality = 0;
+        if (s.rootInTB && s.tbScore <= VALUE_DRAW)
+            s.tbCardinality = 0;
     }
 
-    if (RootInTB && !UseRule50)
-        TB::Score =  TB::Score > VALUE_DRAW ?  VALUE_MATE - MAX_PLY - 1
-                   : TB::Score < VALUE_DRAW ? -VALUE_MATE + MAX_PLY + 1
+    if (s.rootInTB && !s.tbUseRule50)
+        s.tbScore =  s.tbScore > VALUE_DRAW ?  VALUE_MATE - MAX_PLY - 1
+                   : s.tbScore < VALUE_DRAW ? -VALUE_MATE + MAX_PLY + 1
                                             :  VALUE_DRAW;
 }
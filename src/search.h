@@ -21,6 +21,8 @@
 #ifndef SEARCH_H_INCLUDED
 #define SEARCH_H_INCLUDED
 
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "misc.h"
@@ -69,7 +71,7 @@ struct RootMove {
   Value score = -VALUE_INFINITE;
   Value previousScore = -VALUE_INFINITE;
   int selDepth = 0;
-  std::vector<Move> pv;
+  ValueList<Move, MAX_PLY + 1> pv;
 };
 
 typedef std::vector<RootMove> RootMoves;
@@ -82,7 +84,7 @@ struct LimitsType {
 
   LimitsType() { // Init explicitly due to broken value-initialization of non POD in MSVC
     nodes = time[WHITE] = time[BLACK] = inc[WHITE] = inc[BLACK] =
-    npmsec = movestogo = depth = movetime = mate = perft = infinite = 0;
+    npmsec = movestogo = depth = movetime = mate = perft = divide = infinite = 0;
   }
 
   bool use_time_management() const {
@@ -90,16 +92,20 @@ struct LimitsType {
   }
 
   std::vector<Move> searchmoves;
+  std::string batch; // File of the positions searched by the "batch" command
   int time[COLOR_NB], inc[COLOR_NB], npmsec, movestogo, depth,
-      movetime, mate, perft, infinite;
+      movetime, mate, perft, divide, infinite;
   int64_t nodes;
   TimePoint startTime;
 };
 
-extern LimitsType Limits;
+/// State holds what the threads of an engine instance share while searching,
+/// besides the limits. It is defined in search.cpp, see Engine.
+struct State;
 
 void init();
 void clear();
+std::shared_ptr<State> new_state();
 
 } // namespace Search
 
@@ -0,0 +1,380 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "globals.h"
+#include "misc.h"
+#include "movegen.h"
+#include "selfplay.h"
+
+using std::string;
+
+namespace SelfPlay {
+
+namespace {
+
+  const int MaxPlies = 1000; // Adjudicated as a draw, the counting rules end games before
+
+  // Match holds the settings of the 'selfplay' command
+  struct Match {
+    int games = 100, concurrency = 1, plies = -1;
+    int nodes = 0, movetime = 0, time = 10000, inc = 100;
+    double elo0 = 0, elo1 = 5;
+    bool sprt = false;
+    std::vector<string> openings; // Arguments of 'position', ending with the moves
+    std::vector<string> options[2]; // 'setoption' commands of each engine
+  };
+
+  // Result of a game for the engine that moves first
+  enum Outcome { LOSS, DRAW, WIN };
+
+  struct Game {
+    Outcome outcome;
+    string reason;
+  };
+
+  // Player is an engine instance writing to a string, where we read its moves
+  struct Player {
+    explicit Player(const std::vector<string>& options) : engine(out) {
+      for (const string& cmd : options)
+          engine.command(cmd);
+    }
+
+    std::ostringstream out;
+    Engine engine;
+  };
+
+  // Totals of the match, updated by the threads playing the games
+  struct Totals {
+    int wdl[3] = {}, timeLosses = 0, running = 0;
+    uint64_t nodes = 0;
+    std::vector<string> log; // Results of the games, printed by the caller
+  };
+
+
+  // opening() returns the opening of a pair of games, after some random moves
+  // played from the list of openings to get different games.
+
+  string opening(const Match& m, int pair, Player& p) {
+
+    string cmd = m.openings[pair % m.openings.size()];
+    PRNG rng(pair + 1);
+
+    for (int i = 0; i < m.plies; ++i)
+    {
+        p.engine.command("position " + cmd);
+        MoveList<LEGAL> legal(p.engine.pos);
+
+        if (!legal.size())
+            break;
+
+        cmd += " " + UCI::move(*(legal.begin() + rng.rand<uint64_t>() % legal.size()));
+    }
+
+    return cmd;
+  }
+
+
+  // play() plays a game from the given opening, players[0] moving first, and
+  // adds the nodes searched by both players.
+
+  Game play(Player* players[], const string& start, const Match& m, uint64_t& nodes) {
+
+    string moves = start;
+    int clock[] = { m.time, m.time };
+
+    for (int ply = 0; ; ++ply)
+    {
+        Player& p = *players[ply & 1];
+        Outcome lost = ply & 1 ? WIN : LOSS;
+
+        p.engine.command("position " + moves);
+        const Position& pos = p.engine.pos;
+
+        if (!MoveList<LEGAL>(pos).size())
+            return pos.checkers() ? Game{ lost, "mate" } : Game{ DRAW, "stalemate" };
+
+        if (pos.is_draw(0))
+            return { DRAW, pos.counting_draw() ? "counting rules" : "repetition" };
+
+        if (ply >= MaxPlies)
+            return { DRAW, "length" };
+
+        std::ostringstream go;
+        bool timed = !m.nodes && !m.movetime;
+        int mine = clock[ply & 1], theirs = clock[~ply & 1];
+
+        if (m.nodes)
+            go << "go nodes " << m.nodes;
+        else if (m.movetime)
+            go << "go movetime " << m.movetime;
+        else
+            go << "go wtime " << (pos.side_to_move() == WHITE ? mine : theirs)
+               << " btime "  << (pos.side_to_move() == WHITE ? theirs : mine)
+               << " winc " << m.inc << " binc " << m.inc;
+
+        TimePoint searchStart = now();
+        p.engine.command(go.str());
+        p.engine.threads.main()->wait_for_search_finished();
+        int used = int(now() - searchStart);
+        nodes += p.engine.threads.nodes_searched();
+
+        flush_output(p.out); // The best move is written by the output thread
+        string text = p.out.str(), move;
+        p.out.str("");
+
+        size_t idx = text.rfind("bestmove ");
+        if (idx != string::npos)
+            std::istringstream(text.substr(idx + 9)) >> move;
+
+        if (move.empty() || move == "(none)")
+            return { lost, "no move" };
+
+        if (timed && (clock[ply & 1] -= used) < 0)
+            return { lost, "time" };
+
+        clock[ply & 1] += m.inc;
+        moves += " " + move;
+    }
+  }
+
+
+  // elo() converts a score per game to an Elo difference
+
+  double elo(double score) {
+
+    score = std::max(0.001, std::min(0.999, score));
+    return 400 * std::log10(score / (1 - score));
+  }
+
+} // namespace
+
+
+/// run() is called when the engine receives the 'selfplay' command, for instance
+/// 'selfplay games 200 concurrency 4 tc 5000+50 first name Hash value 64'. The
+/// arguments, all optional, are:
+///
+///  games <n>              number of games, default 100
+///  concurrency <n>        games played at once, default 1
+///  tc <ms>+<inc>          time control, default 10000+100, or
+///  nodes <n>, movetime <ms>  a limit per move instead
+///  openings <file>        one FEN per line, possibly followed by moves
+///  plies <n>              random moves after the opening, default 8 without a
+///                         file of openings, 0 with one
+///  sprt <elo0> <elo1>     stop when the SPRT accepts one of the hypotheses
+///  first, second          followed by the options of the engine, as in
+///                         'name Threads value 2 name Hash value 64'
+///
+/// The result of each game is printed as it ends, then a summary with the Elo
+/// of the first engine, the log-likelihood ratio of the SPRT, the games per hour
+/// and the speed of all the games together.
+
+void run(std::istream& is) {
+
+  Match m;
+  string token, file;
+  int side = -1;
+
+  while (is >> token)
+  {
+      if (token == "first" || token == "second")
+      {
+          side = token == "second";
+          continue;
+      }
+
+      if (token == "games")            is >> m.games;
+      else if (token == "concurrency") is >> m.concurrency;
+      else if (token == "nodes")       is >> m.nodes;
+      else if (token == "movetime")    is >> m.movetime;
+      else if (token == "openings")    is >> file;
+      else if (token == "plies")       is >> m.plies;
+      else if (token == "sprt")        is >> m.elo0 >> m.elo1, m.sprt = true;
+      else if (token == "tc")
+      {
+          char plus;
+          is >> token;
+          std::istringstream(token) >> m.time >> plus >> m.inc; // Sets 0 if no increment
+      }
+      else if (side >= 0 && token == "name")
+      {
+          m.options[side].push_back("setoption name");
+          continue;
+      }
+      else if (side >= 0 && !m.options[side].empty())
+      {
+          m.options[side].back() += " " + token;
+          continue;
+      }
+      side = -1;
+  }
+
+  if (!file.empty())
+  {
+      std::ifstream f(file);
+      string fen;
+
+      while (std::getline(f, fen))
+          if (!fen.empty())
+              m.openings.push_back("fen " + fen + (fen.find(" moves") == string::npos ? " moves" : ""));
+
+      if (m.openings.empty())
+      {
+          sync_cout << "info string Unable to read openings from " << file << sync_endl;
+          return;
+      }
+  }
+  else
+      m.openings.push_back("startpos moves");
+
+  m.plies = m.plies >= 0 ? m.plies : file.empty() ? 8 : 0;
+  m.concurrency = std::max(1, std::min(m.concurrency, m.games));
+
+  Threads.main()->wait_for_search_finished();
+
+  // Create the players here, option setup is not thread safe
+  std::vector<std::unique_ptr<Player>> players;
+  for (int i = 0; i < 2 * m.concurrency; ++i)
+      players.emplace_back(new Player(m.options[i & 1]));
+
+  Totals totals;
+  Mutex mutex;
+  ConditionVariable cv;
+  std::atomic<int> next(0);
+  std::atomic_bool stop(false);
+  std::vector<std::thread> workers;
+  TimePoint start = now();
+
+  totals.running = m.concurrency;
+
+  for (int i = 0; i < m.concurrency; ++i)
+      workers.emplace_back([&, i]() {
+
+          Player& first = *players[2 * i];
+          Player& second = *players[2 * i + 1];
+          int g;
+
+          while (!stop && (g = next++) < m.games)
+          {
+              // The second game of a pair reverses the colors
+              bool swap = g & 1;
+              Player* order[] = { swap ? &second : &first, swap ? &first : &second };
+
+              first.engine.command("ucinewgame");
+              second.engine.command("ucinewgame");
+
+              uint64_t nodes = 0;
+              Game game = play(order, opening(m, g / 2, first), m, nodes);
+              Outcome result = swap ? Outcome(WIN - game.outcome) : game.outcome;
+
+              std::ostringstream ss;
+              ss << "Game " << g + 1 << " " << (swap ? "second - first " : "first - second ")
+                 << (game.outcome == WIN ? "1-0" : game.outcome == LOSS ? "0-1" : "1/2-1/2")
+                 << " (" << game.reason << ")";
+
+              std::unique_lock<Mutex> lk(mutex);
+              totals.wdl[result]++;
+              totals.timeLosses += game.reason == "time";
+              totals.nodes += nodes;
+              totals.log.push_back(ss.str());
+              lk.unlock();
+              cv.notify_one();
+          }
+
+          std::unique_lock<Mutex> lk(mutex);
+          totals.running--;
+          lk.unlock();
+          cv.notify_one();
+      });
+
+  // Print the games as they end, and compute the statistics of the match,
+  // with the normal approximation of the distribution of the results.
+  double lower = std::log(0.05 / 0.95), upper = std::log(0.95 / 0.05);
+  double score = 0, variance = 0, llr = 0;
+  int n = 0;
+  size_t printed = 0;
+  std::unique_lock<Mutex> lk(mutex);
+
+  while (totals.running || printed < totals.log.size())
+  {
+      cv.wait(lk, [&]{ return !totals.running || printed < totals.log.size(); });
+
+      for ( ; printed < totals.log.size(); ++printed)
+          sync_cout << totals.log[printed] << sync_endl;
+
+      const int* wdl = totals.wdl;
+      n = wdl[WIN] + wdl[DRAW] + wdl[LOSS];
+
+      if (!n)
+          continue;
+
+      score = (wdl[WIN] + 0.5 * wdl[DRAW]) / n;
+      variance = (  wdl[WIN]  * (1 - score) * (1 - score)
+                  + wdl[DRAW] * (0.5 - score) * (0.5 - score)
+                  + wdl[LOSS] * score * score) / n;
+
+      double s0 = 1 / (1 + std::pow(10, -m.elo0 / 400));
+      double s1 = 1 / (1 + std::pow(10, -m.elo1 / 400));
+      llr = variance > 0 ? n * (s1 - s0) * (2 * score - s0 - s1) / (2 * variance) : 0;
+
+      if (m.sprt && (llr <= lower || llr >= upper))
+          stop = true;
+  }
+
+  lk.unlock();
+
+  for (std::thread& th : workers)
+      th.join();
+
+  TimePoint elapsed = now() - start + 1;
+  double margin = 1.96 * std::sqrt(variance / std::max(n, 1));
+
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(2)
+     << "\n==========================="
+     << "\nGames           : " << n
+     << "\nWins            : " << totals.wdl[WIN]
+     << "\nLosses          : " << totals.wdl[LOSS]
+     << "\nDraws           : " << totals.wdl[DRAW]
+     << "\nTime losses     : " << totals.timeLosses
+     << "\nElo             : " << elo(score) << " +/- " << (elo(score + margin) - elo(score - margin)) / 2;
+
+  if (m.sprt)
+      ss << "\nLLR             : " << llr << " (" << lower << ", " << upper << ") ["
+                                  << m.elo0 << ", " << m.elo1 << "]"
+                                  << (llr >= upper ? " H1 accepted" : llr <= lower ? " H0 accepted" : "");
+
+  ss << "\nGames/hour      : " << 3600000.0 * n / elapsed
+     << "\nNodes/second    : " << 1000 * totals.nodes / elapsed;
+
+  sync_cout << ss.str() << sync_endl;
+}
+
+} // namespace SelfPlay
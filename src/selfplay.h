@@ -0,0 +1,40 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SELFPLAY_H_INCLUDED
+#define SELFPLAY_H_INCLUDED
+
+#include <istream>
+
+/// SelfPlay runs a match in the process between two sets of options, the
+/// 'first' and the 'second' engine, to measure the playing throughput and the
+/// strength difference under game load. Each game is played by two Engine
+/// instances, several games at once, and each opening is played twice with
+/// the colors reversed. The games end by mate, stalemate, repetition or the
+/// Makruk counting rules, as adjudicated by Position, or on time. The options
+/// that change process-wide settings (see Engine) must not differ.
+
+namespace SelfPlay {
+
+void run(std::istream& args);
+
+} // namespace SelfPlay
+
+#endif // #ifndef SELFPLAY_H_INCLUDED
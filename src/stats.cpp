@@ -0,0 +1,99 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include "globals.h"
+#include "stats.h"
+#include "thread.h"
+
+namespace Stats {
+
+#ifdef USE_STATS
+thread_local Counters Local;
+#endif
+
+
+/// clear() resets the counters of a thread, called by Thread::clear()
+
+void clear(Counters* c) {
+
+  if (c)
+      std::memset(c, 0, sizeof(Counters));
+}
+
+
+/// report() sums the counters of all the threads and formats them for the
+/// "stats" command. Threads must be idle.
+
+std::string report() {
+
+  std::stringstream ss;
+
+#ifdef USE_STATS
+  Counters sum;
+  clear(&sum);
+
+  for (Thread* th : Threads)
+      if (th->stats)
+      {
+          for (int i = 0; i < COUNTER_NB; ++i)
+              sum.counter[i] += th->stats->counter[i];
+          for (int i = 0; i < STAGE_NB; ++i)
+              sum.stage[i] += th->stats->stage[i];
+          for (int i = 0; i < CUTOFF_NB; ++i)
+              sum.cutoff[i] += th->stats->cutoff[i];
+      }
+
+  auto rate = [](uint64_t n, uint64_t d) { return d ? 100.0 * n / d : 0.0; };
+  const uint64_t* c = sum.counter;
+
+  ss << std::fixed << std::setprecision(2)
+     << "Threads          : " << Threads.size()
+     << "\nTT probes        : " << c[TT_PROBE]
+     << "  hits " << c[TT_HIT] << " (" << rate(c[TT_HIT], c[TT_PROBE]) << "%)"
+     << "\nTT saves         : " << c[TT_SAVE]
+     << "  overwrites " << c[TT_OVERWRITE] << " (" << rate(c[TT_OVERWRITE], c[TT_SAVE]) << "%)"
+     << "\nPawn probes      : " << c[PAWN_PROBE]
+     << "  hits " << c[PAWN_HIT] << " (" << rate(c[PAWN_HIT], c[PAWN_PROBE]) << "%)"
+     << "\nMaterial probes  : " << c[MATERIAL_PROBE]
+     << "  hits " << c[MATERIAL_HIT] << " (" << rate(c[MATERIAL_HIT], c[MATERIAL_PROBE]) << "%)"
+     << "\nBeta cutoffs     : " << c[BETA_CUTOFF]
+     << "\n\nLast MovePicker stage reached:";
+
+  for (int i = 0; i < STAGE_NB; ++i)
+      if (sum.stage[i])
+          ss << "\n  stage " << std::setw(2) << i << " : " << sum.stage[i];
+
+  ss << "\n\nCutoff move index:";
+
+  for (int i = 0; i < CUTOFF_NB; ++i)
+      ss << "\n  " << std::setw(2) << i + 1 << (i == CUTOFF_NB - 1 ? "+" : " ")
+         << " : " << rate(sum.cutoff[i], c[BETA_CUTOFF]) << "%";
+#else
+  ss << "Statistics are not compiled in, build with 'make build stats=yes'";
+#endif
+
+  return ss.str();
+}
+
+} // namespace Stats
@@ -0,0 +1,69 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2008 Tord Romstad (Glaurung author)
+  Copyright (C) 2008-2015 Marco Costalba, Joona Kiiski, Tord Romstad
+  Copyright (C) 2015-2017 Marco Costalba, Joona Kiiski, Gary Linscott, Tord Romstad
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STATS_H_INCLUDED
+#define STATS_H_INCLUDED
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+/// Stats collects search and hash table statistics per thread. It is compiled
+/// in only with USE_STATS (make stats=yes), otherwise every STATS_* macro is
+/// empty and the counters cost nothing. Each thread updates its own thread
+/// local Counters, the "stats" command sums them over the thread pool.
+
+namespace Stats {
+
+enum Counter {
+  TT_PROBE, TT_HIT, TT_SAVE, TT_OVERWRITE,
+  PAWN_PROBE, PAWN_HIT, MATERIAL_PROBE, MATERIAL_HIT,
+  BETA_CUTOFF, COUNTER_NB
+};
+
+constexpr int STAGE_NB = 32;   // Upper bound on MovePicker stages
+constexpr int CUTOFF_NB = 16;  // Last slot counts all later cutoff moves
+
+struct Counters {
+  uint64_t counter[COUNTER_NB];
+  uint64_t stage[STAGE_NB];      // Last stage reached by each MovePicker
+  uint64_t cutoff[CUTOFF_NB];    // Index of the move failing high, from 0
+};
+
+#ifdef USE_STATS
+extern thread_local Counters Local;
+#endif
+
+void clear(Counters* c);
+std::string report();
+
+} // namespace Stats
+
+#ifdef USE_STATS
+#  define STATS_INC(c)      (++Stats::Local.counter[Stats::c])
+#  define STATS_STAGE(s)    (++Stats::Local.stage[s])
+#  define STATS_CUTOFF(n)   (++Stats::Local.cutoff[std::min(int(n), Stats::CUTOFF_NB - 1)])
+#else
+#  define STATS_INC(c)
+#  define STATS_STAGE(s)
+#  define STATS_CUTOFF(n)
+#endif
+
+#endif // #ifndef STATS_H_INCLUDED
@@ -21,21 +21,29 @@
 #include <algorithm> // For std::count
 #include <cassert>
 
+#include "globals.h"
 #include "movegen.h"
 #include "search.h"
 #include "thread.h"
+#include "uci.h"
 #include "syzygy/tbprobe.h"
 
-ThreadPool Threads; // Global object
+namespace {
+
+  const int64_t SpinTime = 1000; // In microseconds, before parking an idle thread
+
+}
 
 
 /// Thread constructor launches the thread and waits until it goes to sleep
-/// in idle_loop(). Note that 'searching' and 'exit' should be alredy set.
+/// in idle_loop(). The thread is launched only once all the members are
+/// initialized, as idle_loop() sets up the tables before going to sleep.
+/// The thread belongs to the current engine.
 
-Thread::Thread(size_t n) : idx(n), stdThread(&Thread::idle_loop, this) {
+Thread::Thread(size_t n) : idx(n), engine(Engine::CurrentEngine) {
 
+  stdThread = std::thread(&Thread::idle_loop, this);
   wait_for_search_finished();
-  clear(); // Zero-init histories (based on std::array)
 }
 
 
@@ -56,6 +64,11 @@ Thread::~Thread() {
 
 void Thread::clear() {
 
+  sharedProbes = sharedHits = 0;
+  Stats::clear(stats);
+  Profile::clear(profile);
+  pawnsTable.hits = pawnsTable.misses = 0;
+  materialTable.hits = materialTable.misses = 0;
   counterMoves.fill(MOVE_NONE);
   mainHistory.fill(0);
 
@@ -91,72 +104,98 @@ void Thread::wait_for_search_finished() {
 
 void Thread::idle_loop() {
 
-  WinProcGroup::bindThisThread(idx);
+  Engine::CurrentEngine = engine;
+
+  // Bind the thread before it touches its tables, then let it allocate and
+  // zero-init them, so that with a first-touch policy they are local to the
+  // node the thread runs on.
+  NumaBinding::bindThisThread(idx);
+
+#ifdef USE_STATS
+  stats = &Stats::Local;
+#endif
+#ifdef USE_PROFILE
+  profile = &Profile::Local;
+#endif
+
+  pawnsTable.resize(size_t(Options["Pawn Hash"]) * 1024);
+  materialTable.resize(size_t(Options["Material Hash"]) * 1024);
+  clear(); // Zero-init histories (based on std::array)
 
   while (true)
   {
       std::unique_lock<Mutex> lk(mutex);
       searching = false;
       cv.notify_one(); // Wake up anyone waiting for search finished
-      cv.wait(lk, [&]{ return searching; });
+      lk.unlock();
+
+      // Spin for a while before parking, as with fast time controls the next
+      // search starts soon and waking up a parked thread takes much longer.
+      for (int64_t start = now_us(); !searching && now_us() - start < SpinTime; )
+          std::this_thread::yield();
+
+      lk.lock();
+      cv.wait(lk, [&]{ return bool(searching); });
 
       if (exit)
           return;
 
       lk.unlock();
 
+      // Each thread sets up its own root, in parallel with the others. The
+      // StateInfo fields that cannot be deduced from a fen string, like
+      // 'previous', are restored from the copy made by start_thinking().
+      rootMoves = Threads.rootMoves;
+      rootPos.set(Threads.rootFen, Threads.rootChess960, &rootState, this);
+      rootState = Threads.rootState;
+      startLatency = now_us() - Threads.goTime;
+
       search();
   }
 }
 
 
-/// ThreadPool::init() creates and launches the threads that will go
-/// immediately to sleep in idle_loop. We cannot use the constructor because
-/// Threads is a static object and we need a fully initialized engine at
-/// this point due to allocation of Endgames in the Thread constructor.
-
-void ThreadPool::init(size_t requested) {
-
-  push_back(new MainThread(0));
-  set(requested);
-}
-
-
-/// ThreadPool::exit() terminates threads before the program exits. Cannot be
-/// done in the destructor because threads must be terminated before deleting
-/// any static object, so before main() returns.
-
-void ThreadPool::exit() {
-
-  main()->wait_for_search_finished();
-  set(0);
-}
+/// ThreadPool::set() creates/destroys threads to match the requested number.
+/// Created and launched threads will go immediately to sleep in idle_loop.
+/// Upon resizing, threads are recreated to allow for binding if necessary,
+/// because the node of each thread depends on the total number of threads.
+/// We cannot use the constructor and destructor because the threads rely on
+/// the other members of their Engine, that should be valid during the whole
+/// thread lifetime. So set(0) is called by the Engine destructor.
 
+void ThreadPool::set(size_t requested) {
 
-/// ThreadPool::set() creates/destroys threads to match the requested number
+  if (size() > 0) // Destroy any existing thread(s)
+  {
+      main()->wait_for_search_finished();
 
-void ThreadPool::set(size_t requested) {
+      while (size() > 0)
+          delete back(), pop_back();
+  }
 
-  while (size() < requested)
-      push_back(new Thread(size()));
+  if (requested > 0) // Create new thread(s)
+  {
+      push_back(new MainThread(0));
 
-  while (size() > requested)
-      delete back(), pop_back();
+      while (size() < requested)
+          push_back(new Thread(size()));
+  }
 }
 
 
 /// ThreadPool::start_thinking() wakes up main thread waiting in idle_loop() and
 /// returns immediately. Main thread will wake up other threads and start the search.
 
-void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
+void ThreadPool::start_thinking(Position& pos, const StateList& states,
                                 const Search::LimitsType& limits, bool ponderMode) {
 
   main()->wait_for_search_finished();
 
+  goTime = now_us();
   stopOnPonderhit = stop = false;
   ponder = ponderMode;
-  Search::Limits = limits;
-  Search::RootMoves rootMoves;
+  Limits = limits;
+  rootMoves.clear();
 
   for (const auto& m : MoveList<LEGAL>(pos))
       if (   limits.searchmoves.empty()
@@ -166,29 +205,34 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
   if (!rootMoves.empty())
       Tablebases::filter_root_moves(pos, rootMoves);
 
-  // After ownership transfer 'states' becomes empty, so if we stop the search
-  // and call 'go' again without setting a new position states.get() == NULL.
-  assert(states.get() || setupStates.get());
-
-  if (states.get())
-      setupStates = std::move(states); // Ownership transfer, states is now empty
-
-  // We use Position::set() to set root position across threads. But there are
-  // some StateInfo fields (previous, pliesFromNull, capturedPiece) that cannot
-  // be deduced from a fen string, so set() clears them and to not lose the info
-  // we need to backup and later restore setupStates->back(). Note that setupStates
-  // is shared by threads but is accessed in read-only mode.
-  StateInfo tmp = setupStates->back();
+  // Copy the setup states that draw detection can reach from the root, the
+  // root one and the pliesFromNull before it, and link them again. Not only the
+  // rule50 ones, because the counting rules can raise rule50 by more than the
+  // plies played, at a capture in the search. Then 'states' can be refilled by
+  // a new position while we are searching, and setupStates keeps its memory
+  // from one search to the next.
+  size_t n = std::min(size_t(states.back().pliesFromNull) + 1, states.size());
+
+  setupStates.assign(states.end() - n, states.end());
+
+  for (size_t i = 0; i < n; ++i)
+      setupStates[i].previous = i ? &setupStates[i - 1] : nullptr;
+
+  // The threads set up their root position with Position::set() when they
+  // wake up. But there are some StateInfo fields (previous, pliesFromNull,
+  // capturedPiece) that cannot be deduced from a fen string, so set() clears
+  // them and to not lose the info each thread restores its copy from
+  // rootState. Note that setupStates is shared by threads but is accessed in
+  // read-only mode.
+  rootFen = pos.fen();
+  rootChess960 = pos.is_chess960();
+  rootState = setupStates.back();
 
   for (Thread* th : Threads)
   {
       th->nodes = th->tbHits = 0;
       th->rootDepth = th->completedDepth = DEPTH_ZERO;
-      th->rootMoves = rootMoves;
-      th->rootPos.set(pos.fen(), pos.is_chess960(), &setupStates->back(), th);
   }
 
-  setupStates->back() = tmp;
-
   main()->start_searching();
 }
@@ -31,9 +31,12 @@
 #include "movepick.h"
 #include "pawns.h"
 #include "position.h"
+#include "profile.h"
 #include "search.h"
+#include "stats.h"
 #include "thread_win32.h"
 
+class Engine;
 
 /// Thread class keeps together all the thread-related stuff. We use
 /// per-thread pawn and material hash tables so that once we get a
@@ -45,7 +48,9 @@ class Thread {
   Mutex mutex;
   ConditionVariable cv;
   size_t idx;
-  bool exit = false, searching = true; // Set before starting std::thread
+  Engine* engine; // Instance that created the thread
+  bool exit = false;
+  std::atomic_bool searching {true}; // Polled while spinning in idle_loop()
   std::thread stdThread;
 
 public:
@@ -59,14 +64,20 @@ public:
 
   Pawns::Table pawnsTable;
   Material::Table materialTable;
-  Endgames endgames;
   size_t PVIdx;
   int selDepth;
   std::atomic<uint64_t> nodes, tbHits;
+  uint64_t sharedProbes, sharedHits;
+  Stats::Counters* stats = nullptr; // Thread local counters, set in idle_loop()
+  Profile::Counters* profile = nullptr;
 
   Position rootPos;
+  StateInfo rootState;
   Search::RootMoves rootMoves;
+  int64_t startLatency; // From 'go' to the start of the search, in microseconds
   Depth rootDepth, completedDepth;
+  Value drawValue[COLOR_NB]; // Draw scores with contempt, from the root side
+  bool inBatch = false;      // Searching its own position, see batch_root()
   CounterMoveHistory counterMoves;
   ButterflyHistory mainHistory;
   ContinuationHistory contHistory;
@@ -86,6 +97,7 @@ struct MainThread : public Thread {
   double bestMoveChanges;
   Value previousScore;
   int callsCnt;
+  TimePoint lastInfoTime = now();
 };
 
 
@@ -95,19 +107,24 @@ struct MainThread : public Thread {
 
 struct ThreadPool : public std::vector<Thread*> {
 
-  void init(size_t); // No constructor and destructor, threads rely on globals that should
-  void exit();       // be initialized and valid during the whole thread lifetime.
-  void start_thinking(Position&, StateListPtr&, const Search::LimitsType&, bool = false);
+  void start_thinking(Position&, const StateList&, const Search::LimitsType&, bool = false);
   void set(size_t);
 
   MainThread* main()        const { return static_cast<MainThread*>(front()); }
   uint64_t nodes_searched() const { return accumulate(&Thread::nodes); }
   uint64_t tb_hits()        const { return accumulate(&Thread::tbHits); }
 
-  std::atomic_bool stop, ponder, stopOnPonderhit;
+  std::atomic_bool stop {false}, ponder {false}, stopOnPonderhit {false};
+
+  // Root of the search, copied by each thread when it wakes up
+  std::string rootFen;
+  bool rootChess960;
+  StateInfo rootState;
+  Search::RootMoves rootMoves;
+  int64_t goTime;
 
 private:
-  StateListPtr setupStates;
+  StateList setupStates;
 
   uint64_t accumulate(std::atomic<uint64_t> Thread::* member) const {
 
@@ -118,6 +135,4 @@ private:
   }
 };
 
-extern ThreadPool Threads;
-
 #endif // #ifndef THREAD_H_INCLUDED
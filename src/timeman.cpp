@@ -20,11 +20,11 @@
 
 #include <algorithm>
 
+#include "globals.h"
 #include "search.h"
 #include "timeman.h"
 #include "uci.h"
 
-TimeManagement Time; // Our global time management object
 
 namespace {
 
@@ -87,6 +87,25 @@ void TimeManagement::init(Search::LimitsType& limits, Color us, int ply)
   int npmsec       = Options["nodestime"];
   bool ponder      = Options["Ponder"];
 
+  // The GUI charged our last move with the difference of our clocks, if the
+  // game went on from it and the time control did not add time in between.
+  // The excess over the time we measured is the latency of the round trip.
+  if (   last.used >= 0 && last.us == us && last.ply + 2 == ply
+      && last.movestogo != 1 && limits.time[us] > 0 && !npmsec)
+  {
+      int sample = std::min(5000, std::max(0, int(last.time + last.inc - limits.time[us] - last.used)));
+      lag = lag < 0 ? sample : std::max(sample, lag - lag / 8);
+  }
+
+  // Record the clock, finish() will set the time we take unless the GUI charges
+  // it differently, from 'ponderhit' when pondering.
+  last = { us, ply, limits.time[us], limits.inc[us], limits.movestogo,
+           limits.use_time_management() && !Threads.ponder && !npmsec, -1 };
+
+  // Keep a margin of half the latency, as it varies from move to move
+  if (Options["Adaptive Overhead"] && lag >= 0 && !npmsec)
+      moveOverhead = std::min(5000, lag + lag / 2 + 10);
+
   // If we have to play in 'nodes as time' mode, then convert from time
   // to nodes, and use resulting values in time management formulas.
   // WARNING: Given npms (nodes per millisecond) must be much lower then
@@ -110,3 +129,42 @@ void TimeManagement::init(Search::LimitsType& limits, Color us, int ply)
   maximumTime = remaining(limits.time[us], limits.inc[us], moveOverhead,
                           limits.movestogo, moveNum, ponder, MaxTime);
 }
+
+
+/// elapsed() returns the time since the start of the search, in nodes when in
+/// 'nodes as time' mode.
+
+int TimeManagement::elapsed() const {
+
+  return int(Limits.npmsec ? Threads.nodes_searched() : now() - startTime);
+}
+
+
+/// finish() is called at the end of a search, before sending the best move, to
+/// measure the time taken for the latency and the speed of the search.
+
+void TimeManagement::finish(uint64_t nodes) {
+
+  TimePoint used = now() - startTime;
+
+  if (last.timed)
+      last.used = used;
+
+  // Too short searches give a poor measure of the speed
+  if (used >= 20 && !Limits.npmsec)
+  {
+      int64_t sample = int64_t(nodes * 1000 / used);
+      speed = speed ? (speed + sample) / 2 : sample;
+  }
+}
+
+
+/// clear() is called at 'ucinewgame' and forgets the latency of the previous
+/// game. The speed is kept, it depends on the machine.
+
+void TimeManagement::clear() {
+
+  availableNodes = 0;
+  last.used = -1;
+  lag = -1;
+}
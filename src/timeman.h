@@ -26,23 +26,38 @@
 #include "thread.h"
 
 /// The TimeManagement class computes the optimal time to think depending on
-/// the maximum available time, the game move number and other parameters.
+/// the maximum available time, the game move number and other parameters. It
+/// also measures, over the game, the speed of the search and the latency of the
+/// GUI: the time its clock charges for a move beyond the time we took to find it.
+/// With "Adaptive Overhead" the latency replaces the "Move Overhead" setting.
 
 class TimeManagement {
 public:
   void init(Search::LimitsType& limits, Color us, int ply);
+  void finish(uint64_t nodes);
+  void clear();
   int optimum() const { return optimumTime; }
   int maximum() const { return maximumTime; }
-  int elapsed() const { return int(Search::Limits.npmsec ? Threads.nodes_searched() : now() - startTime); }
+  int elapsed() const;
+  int64_t nps() const { return speed; }
 
-  int64_t availableNodes; // When in 'nodes as time' mode
+  int64_t availableNodes = 0; // When in 'nodes as time' mode
 
 private:
+  // The clock at the start of our last search, to measure the latency
+  struct LastMove {
+    Color us;
+    int ply, time, inc, movestogo;
+    bool timed;     // A timed search of ours, not 'go ponder' or 'nodestime'
+    TimePoint used; // Time we took, -1 if not measured
+  };
+
   TimePoint startTime;
   int optimumTime;
   int maximumTime;
+  LastMove last = { WHITE, 0, 0, 0, 0, false, -1 };
+  int lag = -1;      // Decaying maximum of the latencies, -1 before a measure
+  int64_t speed = 0; // Nodes per second, averaged over the searches
 };
 
-extern TimeManagement Time;
-
 #endif // #ifndef TIMEMAN_H_INCLUDED
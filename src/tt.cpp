@@ -19,48 +19,106 @@
 */
 
 #include <cstring>   // For std::memset
+#include <fstream>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 #include "bitboard.h"
+#include "globals.h"
+#include "profile.h"
 #include "tt.h"
+#include "uci.h"
 
-TranspositionTable TT; // Our global transposition table
+
+namespace {
+
+/// Header of a transposition table saved to disk. It is padded to a cache line
+/// so that the clusters following it keep their alignment if the file is mapped
+/// in memory. The cluster size catches files written by a build with another
+/// TT layout, the version any future change of the entry format.
+
+struct TTFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t clusterSize;
+  uint64_t clusterCount;
+  uint8_t generation;
+  char padding[39];
+};
+
+static_assert(sizeof(TTFileHeader) == 64, "TT file header size incorrect");
+
+const char TTFileMagic[8] = "MKSF-TT";
+const uint32_t TTFileVersion = 1;
+
+} // namespace
 
 
 /// TranspositionTable::resize() sets the size of the transposition table,
 /// measured in megabytes. Transposition table consists of a power of 2 number
 /// of clusters and each cluster consists of ClusterSize number of TTEntry.
+/// Memory is requested from the OS backed by huge pages when possible, and the
+/// kind of pages actually obtained is reported to the GUI whenever it changes.
 
 void TranspositionTable::resize(size_t mbSize) {
 
+  std::string method;
+
   size_t newClusterCount = size_t(1) << msb((mbSize * 1024 * 1024) / sizeof(Cluster));
 
   if (newClusterCount == clusterCount)
       return;
 
-  clusterCount = newClusterCount;
+  aligned_large_pages_free(table, clusterCount * sizeof(Cluster));
 
-  free(mem);
-  mem = calloc(clusterCount * sizeof(Cluster) + CacheLineSize - 1, 1);
+  clusterCount = newClusterCount;
+  table = (Cluster*)aligned_large_pages_alloc(clusterCount * sizeof(Cluster), method);
 
-  if (!mem)
+  if (!table)
   {
       std::cerr << "Failed to allocate " << mbSize
                 << "MB for transposition table." << std::endl;
       exit(EXIT_FAILURE);
   }
 
-  table = (Cluster*)((uintptr_t(mem) + CacheLineSize - 1) & ~(CacheLineSize - 1));
+  if (method != lastMethod)
+      sync_cout << "info string Hash table allocation: " << method << sync_endl;
+
+  lastMethod = method;
+  clear();
 }
 
 
 /// TranspositionTable::clear() overwrites the entire transposition table
 /// with zeros. It is called whenever the table is resized, or when the
-/// user asks the program to clear the table (from the UCI interface).
+/// user asks the program to clear the table (from the UCI interface). The
+/// work is split among as many threads as the search uses, each one bound
+/// as the corresponding search thread, so that on systems with a first-touch
+/// policy the pages are spread over the NUMA nodes as the searchers are.
 
 void TranspositionTable::clear() {
 
-  std::memset(table, 0, clusterCount * sizeof(Cluster));
+  const size_t threadCount = Options["Threads"];
+  Engine* engine = Engine::CurrentEngine;
+  std::vector<std::thread> threads;
+
+  for (size_t idx = 0; idx < threadCount; ++idx)
+      threads.emplace_back([this, engine, idx, threadCount]() {
+
+          Engine::Scope scope(engine); // Binding reads the options
+          NumaBinding::bindThisThread(idx);
+
+          // Each thread zeroes its own slice, the last one takes the remainder
+          const size_t stride = clusterCount / threadCount,
+                       start  = stride * idx,
+                       len    = idx != threadCount - 1 ? stride : clusterCount - start;
+
+          std::memset(&table[start], 0, len * sizeof(Cluster));
+      });
+
+  for (std::thread& th : threads)
+      th.join();
 }
 
 
@@ -74,15 +132,22 @@ void TranspositionTable::clear() {
 TTEntry* TranspositionTable::probe(const Key key, bool& found) const {
 
   TTEntry* const tte = first_entry(key);
-  const uint16_t key16 = key >> 48;  // Use the high 16 bits as key inside the cluster
+  const TTKey ttKey = tt_key(key);  // The part of the key stored inside the cluster
+
+  PROFILE_SCOPE(TT_PROBE);
+  STATS_INC(TT_PROBE);
 
   for (int i = 0; i < ClusterSize; ++i)
-      if (!tte[i].key16 || tte[i].key16 == key16)
+      if (!tte[i].key || tte[i].key == ttKey)
       {
-          if ((tte[i].genBound8 & 0xFC) != generation8 && tte[i].key16)
+#ifdef USE_STATS
+          if (tte[i].key)
+              STATS_INC(TT_HIT);
+#endif
+          if ((tte[i].genBound8 & 0xFC) != generation8 && tte[i].key)
               tte[i].genBound8 = uint8_t(generation8 | tte[i].bound()); // Refresh
 
-          return found = (bool)tte[i].key16, &tte[i];
+          return found = (bool)tte[i].key, &tte[i];
       }
 
   // Find an entry to be replaced according to the replacement strategy
@@ -115,3 +180,54 @@ int TranspositionTable::hashfull() const {
   }
   return cnt;
 }
+
+
+/// TranspositionTable::save() writes the transposition table to a file, to be
+/// reloaded later with load(). Returns false in case of I/O error.
+
+bool TranspositionTable::save(const std::string& fname) const {
+
+  TTFileHeader h = {};
+
+  std::memcpy(h.magic, TTFileMagic, sizeof(h.magic));
+  h.version      = TTFileVersion;
+  h.clusterSize  = sizeof(Cluster);
+  h.clusterCount = clusterCount;
+  h.generation   = generation8;
+
+  std::ofstream f(fname, std::ios::binary);
+
+  f.write((const char*)&h, sizeof(h));
+  f.write((const char*)table, clusterCount * sizeof(Cluster));
+  f.close();
+
+  return !f.fail();
+}
+
+
+/// TranspositionTable::load() reads back a transposition table written by
+/// save(), together with its generation. The table must have the same size
+/// and layout of the one saved, otherwise the file is rejected and the current
+/// table is left untouched. If the file is truncated the table is cleared.
+
+bool TranspositionTable::load(const std::string& fname) {
+
+  std::ifstream f(fname, std::ios::binary);
+  TTFileHeader h;
+
+  if (   !f.read((char*)&h, sizeof(h))
+      || std::memcmp(h.magic, TTFileMagic, sizeof(h.magic))
+      || h.version != TTFileVersion
+      || h.clusterSize != sizeof(Cluster)
+      || h.clusterCount != clusterCount)
+      return false;
+
+  if (!f.read((char*)table, clusterCount * sizeof(Cluster)))
+  {
+      clear();
+      return false;
+  }
+
+  generation8 = h.generation;
+  return true;
+}
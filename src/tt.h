@@ -21,7 +21,10 @@
 #ifndef TT_H_INCLUDED
 #define TT_H_INCLUDED
 
+#include <string>
+
 #include "misc.h"
+#include "stats.h"
 #include "types.h"
 
 /// TTEntry struct is the 10 bytes transposition table entry, defined as below:
@@ -33,6 +36,19 @@
 /// generation  6 bit
 /// bound type  2 bit
 /// depth       8 bit
+///
+/// When compiled with USE_WIDE_TT the whole 64 bit key is stored instead, so
+/// that the entry takes 16 bytes and false hits become practically impossible.
+/// This is meant for very long analysis sessions, where the 16 bit check of
+/// the default layout lets too many collisions through.
+
+#ifdef USE_WIDE_TT
+typedef uint64_t TTKey;
+inline TTKey tt_key(Key k) { return k; }
+#else
+typedef uint16_t TTKey;
+inline TTKey tt_key(Key k) { return TTKey(k >> 48); } // Low bits index the cluster
+#endif
 
 struct TTEntry {
 
@@ -47,16 +63,21 @@ struct TTEntry {
     assert(d / ONE_PLY * ONE_PLY == d);
 
     // Preserve any existing move for the same position
-    if (m || (k >> 48) != key16)
+    if (m || tt_key(k) != key)
         move16 = (uint16_t)m;
 
     // Don't overwrite more valuable entries
-    if (  (k >> 48) != key16
+    if (  tt_key(k) != key
         || d / ONE_PLY > depth8 - 4
      /* || g != (genBound8 & 0xFC) // Matching non-zero keys are already refreshed by probe() */
         || b == BOUND_EXACT)
     {
-        key16     = (uint16_t)(k >> 48);
+        STATS_INC(TT_SAVE);
+#ifdef USE_STATS
+        if (key && tt_key(k) != key)
+            STATS_INC(TT_OVERWRITE);
+#endif
+        key       = tt_key(k);
         value16   = (int16_t)v;
         eval16    = (int16_t)ev;
         genBound8 = (uint8_t)(g | b);
@@ -67,7 +88,7 @@ struct TTEntry {
 private:
   friend class TranspositionTable;
 
-  uint16_t key16;
+  TTKey    key;
   uint16_t move16;
   int16_t  value16;
   int16_t  eval16;
@@ -81,28 +102,40 @@ private:
 /// contains information of exactly one position. The size of a cluster should
 /// divide the size of a cache line size, to ensure that clusters never cross
 /// cache lines. This ensures best cache performance, as the cacheline is
-/// prefetched, as soon as possible.
+/// prefetched, as soon as possible. With the default layout two clusters of 3
+/// entries share a cache line, with USE_WIDE_TT a cluster of 4 entries fills it.
 
 class TranspositionTable {
 
   static const int CacheLineSize = 64;
+
+#ifdef USE_WIDE_TT
+  static const int ClusterSize = 4;
+
+  struct Cluster {
+    TTEntry entry[ClusterSize];
+  };
+#else
   static const int ClusterSize = 3;
 
   struct Cluster {
     TTEntry entry[ClusterSize];
     char padding[2]; // Align to a divisor of the cache line size
   };
+#endif
 
   static_assert(CacheLineSize % sizeof(Cluster) == 0, "Cluster size incorrect");
 
 public:
- ~TranspositionTable() { free(mem); }
+ ~TranspositionTable() { aligned_large_pages_free(table, clusterCount * sizeof(Cluster)); }
   void new_search() { generation8 += 4; } // Lower 2 bits are used by Bound
   uint8_t generation() const { return generation8; }
   TTEntry* probe(const Key key, bool& found) const;
   int hashfull() const;
   void resize(size_t mbSize);
   void clear();
+  bool save(const std::string& fname) const;
+  bool load(const std::string& fname);
 
   // The lowest order bits of the key are used to get the index of the cluster
   TTEntry* first_entry(const Key key) const {
@@ -110,12 +143,10 @@ public:
   }
 
 private:
-  size_t clusterCount;
-  Cluster* table;
-  void* mem;
-  uint8_t generation8; // Size must be not bigger than TTEntry::genBound8
+  size_t clusterCount = 0;
+  Cluster* table = nullptr;
+  uint8_t generation8 = 0; // Size must be not bigger than TTEntry::genBound8
+  std::string lastMethod;  // Kind of pages of the last allocation
 };
 
-extern TranspositionTable TT;
-
 #endif // #ifndef TT_H_INCLUDED
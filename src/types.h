@@ -37,6 +37,13 @@
 ///
 /// -DUSE_PEXT    | Add runtime support for use of pext asm-instruction. Works
 ///               | only in 64-bit mode and requires hardware with pext support.
+///
+/// -DUSE_PEXT_DISPATCH | Use pext only if the CPU has a fast one, detected at
+///               | startup, otherwise magics. Requires gcc-style inline asm.
+///
+/// -DUSE_DISPATCH | Compile the function marked HOT_CLONES, Eval::evaluate(),
+///               | for several instruction sets, one is picked at load time.
+///               | Requires gcc or clang with ifunc support (Linux).
 
 #include <cassert>
 #include <cctype>
@@ -75,18 +82,35 @@
 #if defined(USE_PEXT)
 #  include <immintrin.h> // Header for _pext_u64() intrinsic
 #  define pext(b, m) _pext_u64(b, m)
+#elif defined(USE_PEXT_DISPATCH)
+inline uint64_t pext(uint64_t b, uint64_t m) { // Not compiled with -mbmi2
+  uint64_t r;
+  __asm__("pextq %2, %1, %0" : "=r" (r) : "r" (b), "r" (m));
+  return r;
+}
 #else
 #  define pext(b, m) 0
 #endif
 
-#ifdef USE_POPCNT
+#if defined(USE_POPCNT)
 const bool HasPopCnt = true;
+#elif defined(USE_DISPATCH)
+extern const bool HasPopCnt; // Detected at startup, see bitboard.cpp
 #else
 const bool HasPopCnt = false;
 #endif
 
-#ifdef USE_PEXT
+// Not for member functions, whose clones gcc fails to link with lto
+#if defined(USE_DISPATCH)
+#  define HOT_CLONES __attribute__((target_clones("default", "popcnt", "arch=haswell")))
+#else
+#  define HOT_CLONES
+#endif
+
+#if defined(USE_PEXT)
 const bool HasPext = true;
+#elif defined(USE_PEXT_DISPATCH)
+extern const bool HasPext; // Detected at startup, see bitboard.cpp
 #else
 const bool HasPext = false;
 #endif
@@ -18,29 +18,39 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <cmath>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
 
+#include "cluster.h"
 #include "evaluate.h"
+#include "globals.h"
 #include "movegen.h"
 #include "position.h"
+#include "profile.h"
 #include "search.h"
+#include "selfplay.h"
+#include "stats.h"
 #include "thread.h"
 #include "tt.h"
 #include "timeman.h"
 #include "uci.h"
+#include "egtb/egtb.h"
 #include "syzygy/tbprobe.h"
 
 using namespace std;
 
 extern vector<string> setup_bench(const Position&, istream&);
 
-namespace {
+// FEN string of the initial position
+const char* UCI::StartFEN = "rnsmksnr/8/pppppppp/8/8/PPPPPPPP/8/RNSKMSNR w 0 1";
 
-  // FEN string of the initial position, normal chess
-  const char* StartFEN = "rnsmksnr/8/pppppppp/8/8/PPPPPPPP/8/RNSKMSNR w 0 1";
+namespace {
 
 
   // position() is called when engine receives the "position" UCI command.
@@ -48,7 +58,7 @@ namespace {
   // or the starting position ("startpos") and then makes the moves given in the
   // following move list ("moves").
 
-  void position(Position& pos, istringstream& is, StateListPtr& states) {
+  void position(Position& pos, istringstream& is, StateList& states) {
 
     Move m;
     string token, fen;
@@ -57,7 +67,7 @@ namespace {
 
     if (token == "startpos")
     {
-        fen = StartFEN;
+        fen = UCI::StartFEN;
         is >> token; // Consume "moves" token if any
     }
     else if (token == "fen")
@@ -66,15 +76,26 @@ namespace {
     else
         return;
 
-    states = StateListPtr(new std::deque<StateInfo>(1)); // Drop old and create a new one
-    pos.set(fen, Options["UCI_Chess960"], &states->back(), Threads.main());
+    // Reserve a state for each remaining token, at least as many as the moves,
+    // so that the states are not moved while we make the moves. Count all the
+    // whitespace, as operator>> splits the tokens on tabs too.
+    const string& cmd = is.str();
+    size_t moves = std::count_if(cmd.begin() + std::min(size_t(is.tellg()), cmd.size()), cmd.end(),
+                                 [](char c) { return std::isspace(static_cast<unsigned char>(c)); }) + 1;
+
+    states.clear();
+    states.reserve(moves + 1);
+    states.emplace_back();
+    pos.set(fen, Options["UCI_Chess960"], &states.back(), Threads.main());
 
     // Parse move list (if any)
     while (is >> token && (m = UCI::to_move(pos, token)) != MOVE_NONE)
     {
-        states->emplace_back();
-        pos.do_move(m, states->back());
+        states.emplace_back();
+        pos.do_move(m, states.back());
     }
+
+    Engine::CurrentEngine->positionCmd = cmd; // Replayed by the cluster workers
   }
 
 
@@ -106,7 +127,7 @@ namespace {
   // the thinking time and other parameters from the input string, then starts
   // the search.
 
-  void go(Position& pos, istringstream& is, StateListPtr& states) {
+  void go(Position& pos, istringstream& is, StateList& states) {
 
     Search::LimitsType limits;
     string token;
@@ -129,6 +150,7 @@ namespace {
         else if (token == "movetime")  is >> limits.movetime;
         else if (token == "mate")      is >> limits.mate;
         else if (token == "perft")     is >> limits.perft;
+        else if (token == "divide")    is >> limits.perft, limits.divide = 1;
         else if (token == "infinite")  limits.infinite = 1;
         else if (token == "ponder")    ponderMode = true;
 
@@ -136,45 +158,235 @@ namespace {
   }
 
 
+  // batch() is called when engine receives the "batch" command, followed by
+  // the name of a file with one FEN or EPD position per line and the search
+  // depth, 12 by default. The positions are searched in parallel, each by a
+  // single thread, and the results are printed as they come. The command
+  // returns immediately, 'stop' aborts the batch.
+
+  void batch(Position& pos, istringstream& is, StateList& states) {
+
+    Search::LimitsType limits;
+
+    limits.startTime = now();
+    is >> limits.batch;
+
+    if (!(is >> limits.depth))
+        limits.depth = 12;
+
+    Threads.start_thinking(pos, states, limits);
+  }
+
+
   // bench() is called when engine receives the "bench" command. Firstly
   // a list of UCI commands is setup according to bench parameters, then
-  // it is run one by one printing a summary at the end.
+  // it is run one by one printing a summary at the end. The keyword "json",
+  // anywhere in the arguments, adds a machine readable report on stdout. The
+  // others are the ones of setup_bench() followed by the number of runs of
+  // the whole list, for the mean and standard deviation of the speed, where
+  // a count that is not a number is ignored.
 
-  void bench(Position& pos, istream& args, StateListPtr& states) {
+  void bench(Position& pos, istream& args, StateList& states) {
 
-    string token;
-    uint64_t num, nodes = 0, cnt = 1;
+    struct Result { string fen; uint64_t nodes; TimePoint time; int depth, hashfull; };
 
-    vector<string> list = setup_bench(pos, args);
+    string token, params, fen, limit;
+    uint64_t num, nodes = 0, cnt = 1;
+    int64_t latency = 0;
+    int runs = 1;
+    bool json = false;
+
+    for (int i = 0; args >> token; )
+        if (token == "json")
+            json = true;
+        else if (i++ < 5)
+            params += token + " ";
+        else
+            istringstream(token) >> runs; // Sets 0 if not a number
+
+    runs = std::max(runs, 1);
+
+    istringstream paramsStream(params);
+    vector<string> list = setup_bench(pos, paramsStream);
     num = count_if(list.begin(), list.end(), [](string s) { return s.find("go ") == 0; });
 
+    vector<vector<Result>> results(runs);
+    vector<double> runNps;
+
     TimePoint elapsed = now();
 
-    for (const auto& cmd : list)
+    for (int run = 0; run < runs; ++run)
     {
-        istringstream is(cmd);
-        is >> skipws >> token;
+        TimePoint runStart = now();
+        uint64_t runNodes = 0;
 
-        if (token == "go")
+        for (const auto& cmd : list)
         {
-            cerr << "\nPosition: " << cnt++ << '/' << num << endl;
-            go(pos, is, states);
-            Threads.main()->wait_for_search_finished();
-            nodes += Threads.nodes_searched();
+            istringstream is(cmd);
+            is >> skipws >> token;
+
+            if (token == "go")
+            {
+                cerr << "\nPosition: " << cnt++ << '/' << num * runs << endl;
+                TimePoint start = now();
+                go(pos, is, states);
+                Threads.main()->wait_for_search_finished();
+
+                Result r = { fen, Threads.nodes_searched(), now() - start + 1,
+                             Threads.main()->completedDepth / ONE_PLY, TT.hashfull() };
+                results[run].push_back(r);
+                nodes += r.nodes;
+
+                // Time until the last thread starts searching
+                int64_t last = 0;
+                for (Thread* th : Threads)
+                    last = std::max(last, th->startLatency);
+                latency += last;
+                runNodes += r.nodes;
+                limit = cmd.substr(3);
+
+                cerr << "Nodes: " << r.nodes << " Time (ms): " << r.time
+                     << " NPS: " << 1000 * r.nodes / r.time
+                     << " Depth: " << r.depth << " Hashfull: " << r.hashfull << endl;
+            }
+            else if (token == "setoption")  setoption(is);
+            else if (token == "position")   position(pos, is, states), fen = pos.fen();
+            else if (token == "ucinewgame") Search::clear();
         }
-        else if (token == "setoption")  setoption(is);
-        else if (token == "position")   position(pos, is, states);
-        else if (token == "ucinewgame") Search::clear();
+
+        runNps.push_back(1000.0 * runNodes / (now() - runStart + 1));
     }
 
     elapsed = now() - elapsed + 1; // Ensure positivity to avoid a 'divide by zero'
 
+    double mean = 0, variance = 0;
+    for (double v : runNps)
+        mean += v / runs;
+    for (double v : runNps)
+        variance += (v - mean) * (v - mean) / std::max(runs - 1, 1);
+
     dbg_print(); // Just before exiting
 
+    uint64_t pawnHits = 0, pawnProbes = 0, materialHits = 0, materialProbes = 0;
+
+    for (Thread* th : Threads)
+    {
+        pawnHits   += th->pawnsTable.hits;
+        pawnProbes += th->pawnsTable.hits + th->pawnsTable.misses;
+        materialHits   += th->materialTable.hits;
+        materialProbes += th->materialTable.hits + th->materialTable.misses;
+    }
+
+    cerr << "Pawn hash probes " << pawnProbes << " hit rate (%) "
+         << 100 * pawnHits / std::max(pawnProbes, uint64_t(1))
+         << "\nMaterial hash probes " << materialProbes << " hit rate (%) "
+         << 100 * materialHits / std::max(materialProbes, uint64_t(1)) << endl;
+
+    if (Pawns::Shared.enabled())
+        for (size_t i = 0; i < Threads.size(); ++i)
+            cerr << "Shared cache thread " << i << ": probes " << Threads[i]->sharedProbes
+                 << " hit rate (%) " << 100 * Threads[i]->sharedHits / std::max(Threads[i]->sharedProbes, uint64_t(1))
+                 << endl;
+
+    cerr << Profile::report();
+
     cerr << "\n==========================="
+         << "\nStartup (ms)    : " << StartupTime
+         << "\nGo latency (us) : " << latency / int64_t(std::max(num * runs, uint64_t(1)))
          << "\nTotal time (ms) : " << elapsed
          << "\nNodes searched  : " << nodes
          << "\nNodes/second    : " << 1000 * nodes / elapsed << endl;
+
+    if (runs > 1)
+        cerr << "Runs            : " << runs
+             << "\nNPS mean        : " << uint64_t(mean)
+             << "\nNPS stddev      : " << uint64_t(std::sqrt(variance)) << endl;
+
+    if (json)
+    {
+        stringstream ss;
+
+        string name = engine_info(true);
+
+        ss << "{\n  \"engine\": \"" << name.substr(0, name.find('\n')) << "\","
+           << "\n  \"threads\": " << Threads.size() << ","
+           << "\n  \"hash\": " << Options["Hash"] << ","
+           << "\n  \"limit\": \"" << limit << "\","
+           << "\n  \"nps_mean\": " << uint64_t(mean) << ","
+           << "\n  \"nps_stddev\": " << uint64_t(std::sqrt(variance)) << ","
+           << "\n  \"runs\": [";
+
+        for (int run = 0; run < runs; ++run)
+        {
+            ss << (run ? "," : "") << "\n    { \"nps\": " << uint64_t(runNps[run])
+               << ", \"positions\": [";
+
+            for (size_t k = 0; k < results[run].size(); ++k)
+            {
+                const Result& r = results[run][k];
+                ss << (k ? "," : "") << "\n      { \"fen\": \"" << r.fen << "\""
+                   << ", \"nodes\": " << r.nodes << ", \"time\": " << r.time
+                   << ", \"nps\": " << 1000 * r.nodes / r.time
+                   << ", \"depth\": " << r.depth << ", \"hashfull\": " << r.hashfull << " }";
+            }
+
+            ss << " ] }";
+        }
+
+        ss << "\n  ]\n}";
+        sync_cout << ss.str() << sync_endl;
+    }
+  }
+
+
+  // hash_file() handles the 'savehash' and 'loadhash' commands, that write the
+  // transposition table to a file and read it back, so that a long analysis
+  // can be resumed after a restart. Load after 'ucinewgame', that clears it.
+
+  void hash_file(istringstream& is, bool save) {
+
+    string fname;
+    getline(is >> ws, fname);
+
+    Threads.main()->wait_for_search_finished();
+
+    if (save ? TT.save(fname) : TT.load(fname))
+        sync_cout << "info string Hash " << (save ? "saved to " : "loaded from ")
+                  << fname << sync_endl;
+    else
+        sync_cout << "info string Unable to " << (save ? "save hash to " : "load hash from ")
+                  << fname << (save ? "" : ", missing file or different Hash size")
+                  << sync_endl;
+  }
+
+
+
+  // tbgen() handles the 'tbgen' command, that generates the Makruk tablebase
+  // of the given material, like "KRKN", with the tables it depends on. These
+  // are written to the first directory of MakrukTBPath and then loaded.
+
+  void tbgen(istringstream& is) {
+
+    string code, paths = Options["MakrukTBPath"], path = paths;
+    is >> code;
+#ifndef _WIN32
+    const char SepChar = ':';
+#else
+    const char SepChar = ';';
+#endif
+    path = path == "<empty>" ? "." : path.substr(0, path.find(SepChar));
+
+    Threads.main()->wait_for_search_finished();
+
+    std::ostringstream log;
+    bool ok = EGTB::generate(code, path, log);
+
+    istringstream lines(log.str());
+    for (string line; getline(lines, line); )
+        sync_cout << "info string " << line << sync_endl;
+
+    if (ok)
+        EGTB::init(paths == "<empty>" ? path : paths);
   }
 
 } // namespace
@@ -186,14 +398,9 @@ namespace {
 /// run 'bench', once the command is executed the function returns immediately.
 /// In addition to the UCI ones, also some additional debug commands are supported.
 
-void UCI::loop(int argc, char* argv[]) {
-
-  Position pos;
-  string token, cmd;
-  StateListPtr states(new std::deque<StateInfo>(1));
-  auto uiThread = std::make_shared<Thread>(0);
+void UCI::loop(Engine& engine, int argc, char* argv[]) {
 
-  pos.set(StartFEN, false, &states->back(), uiThread.get());
+  string cmd;
 
   for (int i = 1; i < argc; ++i)
       cmd += std::string(argv[i]) + " ";
@@ -202,44 +409,74 @@ void UCI::loop(int argc, char* argv[]) {
       if (argc == 1 && !getline(cin, cmd)) // Block here waiting for input or EOF
           cmd = "quit";
 
-      istringstream is(cmd);
-
-      token.clear(); // Avoid a stale if getline() returns empty or blank line
-      is >> skipws >> token;
-
-      // The GUI sends 'ponderhit' to tell us the user has played the expected move.
-      // So 'ponderhit' will be sent if we were told to ponder on the same move the
-      // user has played. We should continue searching but switch from pondering to
-      // normal search. In case Threads.stopOnPonderhit is set we are waiting for
-      // 'ponderhit' to stop the search, for instance if max search depth is reached.
-      if (    token == "quit"
-          ||  token == "stop"
-          || (token == "ponderhit" && Threads.stopOnPonderhit))
-          Threads.stop = true;
-
-      else if (token == "ponderhit")
-          Threads.ponder = false; // Switch to normal search
-
-      else if (token == "uci")
-          sync_cout << "id name " << engine_info(true)
-                    << "\n"       << Options
-                    << "\nuciok"  << sync_endl;
-
-      else if (token == "setoption")  setoption(is);
-      else if (token == "go")         go(pos, is, states);
-      else if (token == "position")   position(pos, is, states);
-      else if (token == "ucinewgame") Search::clear();
-      else if (token == "isready")    sync_cout << "readyok" << sync_endl;
-
-      // Additional custom non-UCI commands, mainly for debugging
-      else if (token == "flip")  pos.flip();
-      else if (token == "bench") bench(pos, is, states);
-      else if (token == "d")     sync_cout << pos << sync_endl;
-      else if (token == "eval")  sync_cout << Eval::trace(pos) << sync_endl;
-      else
-          sync_cout << "Unknown command: " << cmd << sync_endl;
-
-  } while (token != "quit" && argc == 1); // Command line args are one-shot
+  } while (engine.command(cmd) && argc == 1); // Command line args are one-shot
+}
+
+
+/// UCI::command() executes a command for the current engine, see Engine. It
+/// returns false after 'quit'.
+
+bool UCI::command(const string& cmd) {
+
+  Position& pos = Engine::CurrentEngine->pos;
+  StateList& states = Engine::CurrentEngine->states;
+  string token;
+  istringstream is(cmd);
+
+  is >> skipws >> token;
+
+  // The GUI sends 'ponderhit' to tell us the user has played the expected move.
+  // So 'ponderhit' will be sent if we were told to ponder on the same move the
+  // user has played. We should continue searching but switch from pondering to
+  // normal search. In case Threads.stopOnPonderhit is set we are waiting for
+  // 'ponderhit' to stop the search, for instance if max search depth is reached.
+  if (    token == "quit"
+      ||  token == "stop"
+      || (token == "ponderhit" && Threads.stopOnPonderhit))
+      Threads.stop = true;
+
+  else if (token == "ponderhit")
+      Threads.ponder = false; // Switch to normal search
+
+  else if (token == "uci")
+      sync_cout << "id name " << engine_info(true)
+                << "\n"       << Options
+                << "\nuciok"  << sync_endl;
+
+  else if (token == "setoption")  setoption(is);
+  else if (token == "go")         go(pos, is, states);
+  else if (token == "position")   position(pos, is, states);
+  else if (token == "ucinewgame") Search::clear();
+  else if (token == "isready")    sync_cout << "readyok" << sync_endl;
+
+  // Additional custom non-UCI commands, mainly for debugging
+  else if (token == "flip")  pos.flip();
+  else if (token == "bench") bench(pos, is, states);
+  else if (token == "batch") batch(pos, is, states);
+  else if (token == "selfplay") SelfPlay::run(is);
+  else if (token == "d")     sync_cout << pos << sync_endl;
+  else if (token == "eval")  sync_cout << Eval::trace(pos) << sync_endl;
+  else if (token == "savehash") hash_file(is, true);
+  else if (token == "loadhash") hash_file(is, false);
+  else if (token == "tbgen")    tbgen(is);
+#ifdef USE_CLUSTER
+  else if (token == "serve")
+  {
+      int port = 0;
+      string host;
+      is >> port >> host;
+      Cluster::serve(port, host.empty() ? "127.0.0.1" : host);
+  }
+#endif
+  else if (token == "stats")
+  {
+      Threads.main()->wait_for_search_finished();
+      sync_cout << Stats::report() << sync_endl;
+  }
+  else
+      sync_cout << "Unknown command: " << cmd << sync_endl;
+
+  return token != "quit";
 }
 
 
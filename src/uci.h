@@ -27,6 +27,7 @@
 
 #include "types.h"
 
+class Engine;
 class Position;
 
 namespace UCI {
@@ -69,8 +70,11 @@ private:
   OnChange on_change;
 };
 
+extern const char* StartFEN;
+
 void init(OptionsMap&);
-void loop(int argc, char* argv[]);
+void loop(Engine& engine, int argc, char* argv[]);
+bool command(const std::string& cmd);
 std::string value(Value v);
 std::string square(Square s);
 std::string move(Move m);
@@ -79,6 +83,4 @@ Move to_move(const Position& pos, std::string& str);
 
 } // namespace UCI
 
-extern UCI::OptionsMap Options;
-
 #endif // #ifndef UCI_H_INCLUDED
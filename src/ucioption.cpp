@@ -20,19 +20,22 @@
 
 #include <algorithm>
 #include <cassert>
+#include <iostream>
 #include <ostream>
 
+#include "cluster.h"
+#include "evaluate.h"
+#include "globals.h"
 #include "misc.h"
 #include "search.h"
 #include "thread.h"
 #include "tt.h"
 #include "uci.h"
+#include "egtb/egtb.h"
 #include "syzygy/tbprobe.h"
 
 using std::string;
 
-UCI::OptionsMap Options; // Global object
-
 namespace UCI {
 
 /// 'On change' actions, triggered by an option's value change
@@ -40,7 +43,24 @@ void on_clear_hash(const Option&) { Search::clear(); }
 void on_hash_size(const Option& o) { TT.resize(o); }
 void on_logger(const Option& o) { start_logger(o); }
 void on_threads(const Option& o) { Threads.set(o); }
+void on_eval_tables(const Option&) { Threads.set(Options["Threads"]); }
+void on_numa_binding(const Option&) {
+  Threads.set(Options["Threads"]);
+  sync_cout << "info string " << NumaBinding::topology() << sync_endl;
+}
 void on_tb_path(const Option& o) { Tablebases::init(o); }
+void on_makruk_tb_path(const Option& o) { EGTB::init(o); }
+void on_lazy_threshold(const Option& o) { Eval::LazyThreshold = Value(int(o)); }
+void on_counting(const Option& o) { EnableCounting = o; }
+#ifdef USE_CLUSTER
+void on_cluster_workers(const Option& o) { Cluster::connect(o); }
+void on_cluster_tt_depth(const Option& o) { Cluster::SaveDepth = Depth(int(o) * ONE_PLY); }
+#endif
+void on_shared_cache(const Option& o) {
+  Threads.main()->wait_for_search_finished();
+  Pawns::Shared.resize(size_t(o) * 1024 * 1024 * 3 / 4); // Most of it to pawns
+  Material::Shared.resize(size_t(o) * 1024 * 1024 / 4);
+}
 
 
 /// Our case insensitive less() function as required by UCI protocol
@@ -60,20 +80,33 @@ void init(OptionsMap& o) {
   o["Debug Log File"]        << Option("", on_logger);
   o["Contempt"]              << Option(0, -100, 100);
   o["Threads"]               << Option(1, 1, 512, on_threads);
+  o["NUMA Binding"]          << Option("auto", {"auto", "on", "off"}, on_numa_binding);
+  o["Breadcrumbs"]           << Option(false);
+#ifdef USE_CLUSTER
+  o["Cluster Workers"]       << Option("<empty>", on_cluster_workers);
+  o["Cluster TT Depth"]      << Option(10, 1, 100, on_cluster_tt_depth);
+#endif
   o["Hash"]                  << Option(16, 1, MaxHashMB, on_hash_size);
   o["Clear Hash"]            << Option(on_clear_hash);
+  o["Pawn Hash"]             << Option(2048, 4, 1024 * 1024, on_eval_tables);
+  o["Material Hash"]         << Option(320, 4, 1024 * 1024, on_eval_tables);
+  o["Lazy Threshold"]        << Option(0, 0, 10000, on_lazy_threshold);
+  o["Shared Eval Cache"]     << Option(0, 0, 1024, on_shared_cache);
   o["Ponder"]                << Option(false);
   o["MultiPV"]               << Option(1, 1, 500);
+  o["Parallel MultiPV"]      << Option(false);
   o["Skill Level"]           << Option(20, 0, 20);
   o["Move Overhead"]         << Option(100, 0, 5000);
+  o["Adaptive Overhead"]     << Option(false);
   o["nodestime"]             << Option(0, 0, 10000);
   o["UCI_Chess960"]          << Option(false);
   o["UCI_Variant"]           << Option("makruk", {"makruk"});
-  o["EnableCounting"]        << Option(true);
+  o["EnableCounting"]        << Option(true, on_counting);
   o["SyzygyPath"]            << Option("<empty>", on_tb_path);
   o["SyzygyProbeDepth"]      << Option(1, 1, 100);
   o["Syzygy50MoveRule"]      << Option(true);
   o["SyzygyProbeLimit"]      << Option(6, 0, 6);
+  o["MakrukTBPath"]          << Option("<empty>", on_makruk_tb_path);
 }
 
 
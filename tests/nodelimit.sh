@@ -0,0 +1,48 @@
+#!/bin/bash
+# verify that 'go nodes' stops close to the node budget, with all the threads
+# together, see MainThread::check_time(). The threads are limited to the cores,
+# as a helper thread waiting for a core is not stopped in time.
+
+error()
+{
+  echo "node limit testing failed on line $1"
+  exit 1
+}
+trap 'error ${LINENO}' ERR
+
+echo "node limit testing started"
+
+cores=`nproc 2>/dev/null || echo 1`
+
+for threads in 1 2 4
+do
+  [ $threads -le $cores ] || continue
+
+  for nodes in 1000 20000 100000
+  do
+    coproc SF { ./stockfish; }
+    echo "setoption name Threads value $threads" >&${SF[1]}
+    echo "go nodes $nodes" >&${SF[1]}
+
+    last=""
+    while read -r line <&${SF[0]}
+    do
+      case "$line" in
+        "info depth "*" nodes "*) last="$line" ;;
+        bestmove*) break ;;
+      esac
+    done
+
+    echo "quit" >&${SF[1]}
+    wait $SF_PID
+
+    searched=`echo "$last" | grep -o "nodes [0-9]*" | awk '{print $2}'`
+    echo "node limit testing with $threads threads and $nodes nodes: $searched"
+
+    # at most a few qsearch nodes per thread past the budget
+    [ $searched -ge $nodes ]
+    [ $searched -le $((nodes + 256 * threads)) ]
+  done
+done
+
+echo "node limit testing OK"
@@ -11,9 +11,11 @@ trap 'error ${LINENO}' ERR
 echo "perft testing started"
 
 cat << EOF > perft.exp
-   set timeout 10
-   lassign \$argv pos depth result
+   set timeout 30
+   lassign \$argv pos depth result threads
+   if {\$threads eq ""} { set threads 1 }
    spawn ./stockfish
+   send "setoption name Threads value \$threads\\nsetoption name Hash value 64\\n"
    send "position \$pos\\ngo perft \$depth\\n"
    expect "Nodes searched? \$result" {} timeout {exit 1}
    send "quit\\n"
@@ -21,6 +23,8 @@ cat << EOF > perft.exp
 EOF
 
 expect perft.exp startpos 5 6223994 > /dev/null
+expect perft.exp startpos 6 142078049 2 > /dev/null
+expect perft.exp "fen 3m4/4s2k/2R1p3/2S2pM1/p2NnP2/4P3/4K3/1r6 b 12 45" 5 10037869 4 > /dev/null
 
 rm perft.exp
 
@@ -13,6 +13,14 @@ trap 'error ${LINENO}' ERR
 
 signature=`./stockfish bench 2>&1 | grep "Nodes searched  : " | awk '{print $4}'`
 
+# the json report, with the default arguments, gives the same signature
+
+./stockfish bench json > bench.json 2> bench.err
+grep -q '"nps_mean"' bench.json
+jsonsig=`grep "Nodes searched  : " bench.err | awk '{print $4}'`
+rm -f bench.json bench.err
+[ "$jsonsig" = "$signature" ]
+
 if [ $# -gt 0 ]; then
    # compare to given reference
    if [ "$1" != "$signature" ]; then
@@ -0,0 +1,32 @@
+#!/bin/bash
+# compare the scaling of Lazy SMP with and without breadcrumbs
+# usage: smp_scaling.sh [movetime in ms] [thread counts...]
+
+error()
+{
+  echo "smp scaling testing failed on line $1"
+  exit 1
+}
+trap 'error ${LINENO}' ERR
+
+movetime=${1:-5000}
+shift || true
+threads=${@:-1 8 32 64}
+
+echo "smp scaling testing started"
+
+for t in $threads
+do
+  for crumbs in false true
+  do
+    # average depth reached over the bench positions and total nps
+    (echo "setoption name Breadcrumbs value $crumbs"; echo "bench 256 $t $movetime default movetime"; echo "quit") \
+      | ./stockfish 2>&1 \
+      | awk -v t=$t -v c=$crumbs '
+          /^Nodes: /           { depth += $9; n++ }
+          /^Nodes\/second/     { nps = $3 }
+          END { printf "threads %3d breadcrumbs %-5s depth %5.2f nps %d\n", t, c, depth / n, nps }'
+  done
+done
+
+echo "smp scaling testing OK"